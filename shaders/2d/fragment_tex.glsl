@@ -2,12 +2,13 @@
 
 uniform vec4 color = vec4(1.0);
 uniform sampler2D decal;
+uniform vec3 decalTexel;   // constant texture: texel of the shared atlas (z = 1)
 
 in vec2 v_texcoord;
 out vec4 outcolor;
 
 void main() {
-  vec4 tex = texture(decal, v_texcoord);
+  vec4 tex = texture(decal, decalTexel.z != 0.0 ? decalTexel.xy : v_texcoord);
   outcolor = color * tex;
   // (discard removido para evitar sumiço de pixels em texturas sem canal alpha)
 }
@@ -10,6 +10,9 @@ out vec4 color;
 
 uniform sampler2D decal;
 uniform sampler2D roughness; // roughness map (R channel)
+// constant textures: texel of the shared atlas (z = 1), see Texture
+uniform vec3 decalTexel;
+uniform vec3 roughnessTexel;
 
 uniform vec4 lpos;  // light pos in eye space
 uniform vec4 lamb;
@@ -33,6 +36,11 @@ uniform vec3 fogColor;      // fog color in eye space output
 uniform float fogStart;     // distance where fog starts
 uniform float fogEnd;       // distance where fog fully covers
 
+vec2 TexelUV (vec3 texel, vec2 uv)
+{
+  return texel.z != 0.0 ? texel.xy : uv;
+}
+
 void main (void)
 {
   // Light vector from point to light
@@ -60,7 +68,7 @@ void main (void)
   float vis = attenuation * spot;
 
   // Roughness mapping
-  float rough = clamp(texture(roughness, f.uv).r, 0.0, 1.0);
+  float rough = clamp(texture(roughness, TexelUV(roughnessTexel, f.uv)).r, 0.0, 1.0);
   float gloss = 1.0 - rough; // 0 = fully rough, 1 = fully glossy
   float mshi_eff = mix(8.0, 256.0, gloss);
 
@@ -70,7 +78,7 @@ void main (void)
     float specTerm = pow(max(0.0, dot(R, normalize(-f.veye))), mshi_eff);
     lit += mspe * lspe * (specTerm * vis * gloss);
   }
-  vec4 tex = texture(decal, f.uv);
+  vec4 tex = texture(decal, TexelUV(decalTexel, f.uv));
   vec4 shaded = lit * tex;
 
   // Linear fog based on eye-space distance to camera origin
@@ -11,6 +11,8 @@ uniform mat4 Mvp;
 uniform int  clipCount;            // number of active planes [0..4]
 uniform vec4 clipPlane[4];         // plane eq: n.xyz, d (n.p + d = 0), keep where < 0
 
+#include "vertex_decode.glsl"
+
 // Pass position and normal in eye space to the fragment shader
 out VS_OUT {
   vec3 veye;
@@ -19,9 +21,18 @@ out VS_OUT {
 
 void main (void) 
 {
-  v.veye = vec3(Mv*coord);
-  v.neye = normalize(vec3(Mn*vec4(normal,0.0f)));
-  gl_Position = Mvp*coord; 
+  vec4 pos = coord;
+  vec3 nrm = normal;
+  vec2 uv = vec2(0.0);
+  if (procShape != 0)
+    ProceduralVertex(pos,nrm,uv);
+  else if (quantized != 0) {
+    pos = vec4(qoffset + qscale*coord.xyz,1.0);
+    nrm = OctDecode(normal.xy/32767.0);
+  }
+  v.veye = vec3(Mv*pos);
+  v.neye = normalize(vec3(Mn*vec4(nrm,0.0f)));
+  gl_Position = Mvp*pos; 
 
   // Compute clip distances for up to 4 planes
   vec4 eyePos = vec4(v.veye, 1.0);
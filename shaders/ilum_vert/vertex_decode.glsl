@@ -0,0 +1,80 @@
+// Vertex decoding shared by the ilum_vert vertex shaders (included by
+// Shader at load: keep a single copy here)
+
+// Compact vertices (Geometry::SetCompact): coord holds 16-bit integers
+// dequantized through the entry bounds, normal is octahedral encoded
+uniform int  quantized;
+uniform vec3 qoffset;
+uniform vec3 qscale;
+
+vec3 OctDecode (vec2 e)
+{
+  vec3 n = vec3(e,1.0-abs(e.x)-abs(e.y));
+  float t = max(-n.z,0.0);
+  n.x += n.x >= 0.0 ? -t : t;
+  n.y += n.y >= 0.0 ? -t : t;
+  return normalize(n);
+}
+
+// Procedural shapes (Geometry::SetProcedural): no attributes, the vertex
+// is generated from gl_VertexID over a procNx x procNy grid (two
+// triangles per cell, as Grid), followed by the caps of the shape
+uniform int procShape;             // Geometry::PROCEDURAL (0: attributes)
+uniform int procNx;
+uniform int procNy;
+
+const float PI = 3.14159265;
+
+void ProceduralVertex (out vec4 pos, out vec3 nrm, out vec2 uv)
+{
+  int nside = 6*procNx*procNy;
+  if (gl_VertexID < nside) {
+    int cell = gl_VertexID/6;
+    int k = gl_VertexID - 6*cell;
+    int i = cell%procNx + ((k == 1 || k == 2 || k == 4) ? 1 : 0);
+    int j = cell/procNx + ((k == 2 || k == 4 || k == 5) ? 1 : 0);
+    uv = vec2(float(i)/float(procNx),float(j)/float(procNy));
+    float s = sin(2.0*PI*uv.x);
+    float c = cos(2.0*PI*uv.x);
+    if (procShape == 1) {          // quad
+      pos = vec4(uv,0.0,1.0);
+      nrm = vec3(0.0,0.0,1.0);
+    }
+    else if (procShape == 2) {     // sphere
+      float phi = PI - PI*uv.y;
+      pos = vec4(s*sin(phi),cos(phi),c*sin(phi),1.0);
+      nrm = pos.xyz;
+    }
+    else if (procShape == 3) {     // cylinder
+      pos = vec4(s,uv.y-0.5,c,1.0);
+      nrm = vec3(s,0.0,c);
+    }
+    else {                         // cone
+      float r = 1.0 - uv.y;
+      pos = vec4(r*s,uv.y-0.5,r*c,1.0);
+      nrm = normalize(vec3(s,1.0,c));
+    }
+  }
+  else {
+    // fans of procNx triangles, as Geometry::AppendCap
+    int id = gl_VertexID - nside;
+    int cap = id/(3*procNx);
+    int t = id - 3*procNx*cap;
+    int tri = t/3;
+    int k = t - 3*tri;
+    bool up = procShape == 3 && cap == 0;
+    float y = up ? 0.5 : -0.5;
+    nrm = vec3(0.0,up ? 1.0 : -1.0,0.0);
+    if (k == 0) {
+      pos = vec4(0.0,y,0.0,1.0);
+      uv = vec2(0.5);
+    }
+    else {
+      float ang = 2.0*PI*float(tri+k-1)/float(procNx);
+      float x = cos(ang);
+      float z = sin(ang);
+      pos = vec4(x,y,(up ? -1.0 : 1.0)*z,1.0);
+      uv = vec2(0.5+0.5*x,0.5+0.5*z);
+    }
+  }
+}
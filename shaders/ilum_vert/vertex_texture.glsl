@@ -12,6 +12,8 @@ uniform mat4 Mvp;
 uniform int  clipCount;            // number of active planes [0..4]
 uniform vec4 clipPlane[4];         // plane eq: n.xyz, d (n.p + d = 0), keep where < 0
 
+#include "vertex_decode.glsl"
+
 out VS_OUT {
   vec3 veye;
   vec3 neye;
@@ -20,10 +22,19 @@ out VS_OUT {
 
 void main (void) 
 {
-  v.veye = vec3(Mv*coord);
-  v.neye = normalize(vec3(Mn*vec4(normal,0.0f)));
-  v.uv = texcoord;
-  gl_Position = Mvp*coord; 
+  vec4 pos = coord;
+  vec3 nrm = normal;
+  vec2 uv = texcoord;
+  if (procShape != 0)
+    ProceduralVertex(pos,nrm,uv);
+  else if (quantized != 0) {
+    pos = vec4(qoffset + qscale*coord.xyz,1.0);
+    nrm = OctDecode(normal.xy/32767.0);
+  }
+  v.veye = vec3(Mv*pos);
+  v.neye = normalize(vec3(Mn*vec4(nrm,0.0f)));
+  v.uv = uv;
+  gl_Position = Mvp*pos; 
 
   // Compute clip distances for up to 4 planes
   vec4 eyePos = vec4(v.veye, 1.0);
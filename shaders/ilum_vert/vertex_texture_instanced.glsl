@@ -0,0 +1,54 @@
+#version 410
+
+layout(location = 0) in vec4 coord;
+layout(location = 1) in vec3 normal;
+layout(location = 3) in vec2 texcoord;
+
+uniform mat4 Mvp;                  // lighting space to clip space
+uniform samplerBuffer instances;   // per instance: Mv (4 texels), Mn (4 texels)
+
+// User clip planes in eye space
+uniform int  clipCount;            // number of active planes [0..4]
+uniform vec4 clipPlane[4];         // plane eq: n.xyz, d (n.p + d = 0), keep where < 0
+
+#include "vertex_decode.glsl"
+
+out VS_OUT {
+  vec3 veye;
+  vec3 neye;
+  vec2 uv;
+} v;
+
+mat4 FetchMatrix (int base)
+{
+  return mat4(texelFetch(instances,base+0),
+              texelFetch(instances,base+1),
+              texelFetch(instances,base+2),
+              texelFetch(instances,base+3));
+}
+
+void main (void) 
+{
+  vec4 pos = coord;
+  vec3 nrm = normal;
+  vec2 uv = texcoord;
+  if (procShape != 0)
+    ProceduralVertex(pos,nrm,uv);
+  else if (quantized != 0) {
+    pos = vec4(qoffset + qscale*coord.xyz,1.0);
+    nrm = OctDecode(normal.xy/32767.0);
+  }
+  mat4 Mv = FetchMatrix(8*gl_InstanceID);
+  mat4 Mn = FetchMatrix(8*gl_InstanceID+4);
+  v.veye = vec3(Mv*pos);
+  v.neye = normalize(vec3(Mn*vec4(nrm,0.0f)));
+  v.uv = uv;
+  gl_Position = Mvp*Mv*pos; 
+
+  // Compute clip distances for up to 4 planes
+  vec4 eyePos = vec4(v.veye, 1.0);
+  if (clipCount > 0) gl_ClipDistance[0] = dot(eyePos, clipPlane[0]);
+  if (clipCount > 1) gl_ClipDistance[1] = dot(eyePos, clipPlane[1]);
+  if (clipCount > 2) gl_ClipDistance[2] = dot(eyePos, clipPlane[2]);
+  if (clipCount > 3) gl_ClipDistance[3] = dot(eyePos, clipPlane[3]);
+}
@@ -0,0 +1,102 @@
+#include "arena.h"
+
+#include <cstdlib>
+#include <cstdint>
+#include <iostream>
+
+static char* AllocBlock (size_t bytes)
+{
+  char* p = static_cast<char*>(malloc(bytes));
+  if (!p) {
+    std::cerr << "Arena: out of memory (" << bytes << " bytes)" << std::endl;
+    exit(1);
+  }
+  return p;
+}
+
+static size_t AlignUp (size_t offset, const char* base, size_t align)
+{
+  uintptr_t addr = reinterpret_cast<uintptr_t>(base) + offset;
+  return offset + ((align - addr % align) % align);
+}
+
+ArenaPtr Arena::Make (size_t capacity)
+{
+  return ArenaPtr(new Arena(capacity));
+}
+
+Arena::Arena (size_t capacity)
+: m_block(nullptr),
+  m_capacity(capacity),
+  m_used(0),
+  m_extra_used(0),
+  m_extra_left(0),
+  m_heap_allocs(0)
+{
+  m_block = AllocBlock(m_capacity);
+  m_heap_allocs++;
+  m_extra.reserve(16);
+}
+
+Arena::~Arena ()
+{
+  for (char* p : m_extra)
+    free(p);
+  free(m_block);
+}
+
+void* Arena::Allocate (size_t bytes, size_t align)
+{
+  size_t offset = AlignUp(m_used,m_block,align);
+  if (offset + bytes <= m_capacity) {
+    m_used = offset + bytes;
+    return m_block + offset;
+  }
+  // overflow: serve from the last extra block, or start a new one
+  size_t need = bytes + align;
+  if (m_extra.empty() || m_extra_left < need) {
+    size_t size = need > m_capacity ? need : m_capacity;
+    m_extra.push_back(AllocBlock(size));
+    m_heap_allocs++;
+    m_extra_left = size;
+  }
+  char* base = m_extra.back();
+  // extra blocks are consumed from their end down
+  char* p = base + m_extra_left - bytes;
+  p -= reinterpret_cast<uintptr_t>(p) % align;
+  m_extra_used += (base + m_extra_left) - p;
+  m_extra_left = p - base;
+  return p;
+}
+
+// Rewind; if the frame overflowed, grow the main block to fit it
+void Arena::Reset ()
+{
+  if (!m_extra.empty()) {
+    for (char* p : m_extra)
+      free(p);
+    m_extra.clear();
+    m_capacity = 2*(m_used + m_extra_used);
+    free(m_block);
+    m_block = AllocBlock(m_capacity);
+    m_heap_allocs++;
+  }
+  m_used = 0;
+  m_extra_used = 0;
+  m_extra_left = 0;
+}
+
+size_t Arena::GetUsed () const
+{
+  return m_used + m_extra_used;
+}
+
+size_t Arena::GetCapacity () const
+{
+  return m_capacity;
+}
+
+unsigned int Arena::GetHeapAllocs () const
+{
+  return m_heap_allocs;
+}
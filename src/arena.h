@@ -0,0 +1,55 @@
+#include <memory>
+class Arena;
+using ArenaPtr = std::shared_ptr<Arena>; 
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+// Linear (bump) allocator for per-frame data: allocations are released
+// all at once by Reset. When a frame overflows the block, extra blocks
+// are taken from the heap and merged into a larger one on the next
+// Reset, so steady-state frames do not touch the heap.
+class Arena {
+  char* m_block;
+  size_t m_capacity;
+  size_t m_used;
+  std::vector<char*> m_extra;    // overflow blocks of the current frame
+  size_t m_extra_used;           // bytes served from overflow blocks
+  size_t m_extra_left;           // free bytes in the last overflow block
+  unsigned int m_heap_allocs;    // blocks taken from the heap
+protected:
+  Arena (size_t capacity);
+public:
+  static ArenaPtr Make (size_t capacity);
+  virtual ~Arena ();
+  void* Allocate (size_t bytes, size_t align);
+  template <class T> T* Alloc (size_t n)
+  {
+    return static_cast<T*>(Allocate(n*sizeof(T),alignof(T)));
+  }
+  void Reset ();
+  size_t GetUsed () const;
+  size_t GetCapacity () const;
+  unsigned int GetHeapAllocs () const;
+};
+
+// STL allocator over an arena; deallocation is a no-op (see Arena::Reset)
+template <class T>
+class ArenaAllocator {
+  Arena* m_arena;
+public:
+  using value_type = T;
+  using propagate_on_container_move_assignment = std::true_type;
+  ArenaAllocator (Arena* arena) : m_arena(arena) {}
+  template <class U> ArenaAllocator (const ArenaAllocator<U>& a) : m_arena(a.GetArena()) {}
+  T* allocate (size_t n) { return m_arena->Alloc<T>(n); }
+  void deallocate (T* , size_t ) {}
+  Arena* GetArena () const { return m_arena; }
+  template <class U> bool operator== (const ArenaAllocator<U>& a) const { return m_arena == a.GetArena(); }
+  template <class U> bool operator!= (const ArenaAllocator<U>& a) const { return m_arena != a.GetArena(); }
+};
+
+#endif
@@ -0,0 +1,148 @@
+// BVH benchmark: build, refit and queries against a linear walk.
+// Build with "make bench" and run build/bench_bvh.
+
+#include "bvh.h"
+#include "node.h"
+#include "shape.h"
+#include "transform.h"
+#include "frustum.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cfloat>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// unit box with no GL resources
+class BoxShape : public Shape {
+public:
+  static ShapePtr Make () { return ShapePtr(new BoxShape()); }
+  virtual void Draw (StatePtr ) {}
+  virtual Bounds GetBounds () const
+  {
+    return Bounds(glm::vec3(-0.5f),glm::vec3(0.5f));
+  }
+};
+
+static double Now ()
+{
+  using namespace std::chrono;
+  return duration<double,std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+static float Rand (float a, float b)
+{
+  return a + (b-a)*float(rand())/float(RAND_MAX);
+}
+
+static bool RayBox (const glm::vec3& o, const glm::vec3& d, const Bounds& b, float* t)
+{
+  float t0 = 0.0f, t1 = FLT_MAX;
+  for (int k=0; k<3; ++k) {
+    float inv = 1.0f/d[k];
+    float ta = (b.GetMin()[k]-o[k])*inv;
+    float tb = (b.GetMax()[k]-o[k])*inv;
+    if (ta > tb) std::swap(ta,tb);
+    t0 = ta > t0 ? ta : t0;
+    t1 = tb < t1 ? tb : t1;
+    if (t0 > t1)
+      return false;
+  }
+  *t = t0;
+  return true;
+}
+
+static void Run (int n)
+{
+  const int NQUERY = 100;
+  float size = 10.0f*std::cbrt(float(n));
+  ShapePtr box = BoxShape::Make();
+  NodePtr root = Node::Make();
+  std::vector<Node*> nodes;
+  std::vector<TransformPtr> trfs;
+  for (int i=0; i<n; ++i) {
+    TransformPtr trf = Transform::Make();
+    trf->Translate(Rand(-size,size),Rand(-size,size),Rand(-size,size));
+    trf->Rotate(Rand(0.0f,360.0f),0.0f,1.0f,0.0f);
+    float s = Rand(0.5f,3.0f);
+    trf->Scale(s,s,s);
+    NodePtr node = Node::Make(trf,{box});
+    root->AddNode(node);
+    nodes.push_back(node.get());
+    trfs.push_back(trf);
+  }
+
+  double t = Now();
+  BVHPtr bvh = BVH::Make(nodes);
+  double t_build = Now()-t;
+
+  for (TransformPtr& trf : trfs)
+    trf->Translate(0.1f,0.0f,0.0f);
+  t = Now();
+  bvh->Refit();
+  double t_refit = Now()-t;
+
+  // frustum queries from random viewpoints
+  std::vector<Frustum> frustums;
+  std::vector<glm::vec3> origins, dirs;
+  glm::mat4 proj = glm::perspective(glm::radians(60.0f),1.0f,0.1f,size);
+  for (int i=0; i<NQUERY; ++i) {
+    glm::vec3 eye(Rand(-size,size),Rand(-size,size),Rand(-size,size));
+    glm::vec3 at(Rand(-size,size),Rand(-size,size),Rand(-size,size));
+    frustums.push_back(Frustum(proj*glm::lookAt(eye,at,glm::vec3(0.0f,1.0f,0.0f))));
+    origins.push_back(eye);
+    dirs.push_back(glm::normalize(at-eye));
+  }
+  std::vector<unsigned int> items;
+  size_t nbvh = 0, nlin = 0;
+  t = Now();
+  for (const Frustum& f : frustums) {
+    items.clear();
+    bvh->Query(f,items);
+    nbvh += items.size();
+  }
+  double t_query = (Now()-t)/NQUERY;
+  t = Now();
+  for (const Frustum& f : frustums)
+    for (Node* node : nodes)
+      if (f.Intersects(BVH::GetNodeBounds(node)))
+        nlin++;
+  double t_qlin = (Now()-t)/NQUERY;
+
+  // ray picks
+  int hbvh = 0, hlin = 0;
+  t = Now();
+  for (int i=0; i<NQUERY; ++i)
+    if (bvh->Pick(origins[i],dirs[i]) >= 0)
+      hbvh++;
+  double t_pick = (Now()-t)/NQUERY;
+  t = Now();
+  for (int i=0; i<NQUERY; ++i) {
+    float best = FLT_MAX, th;
+    for (Node* node : nodes)
+      if (RayBox(origins[i],dirs[i],BVH::GetNodeBounds(node),&th) && th < best)
+        best = th;
+    if (best < FLT_MAX)
+      hlin++;
+  }
+  double t_plin = (Now()-t)/NQUERY;
+
+  printf("n=%-7d build %8.3f ms  refit %7.3f ms  tree %u nodes\n",
+         n, t_build, t_refit, bvh->GetTreeSize());
+  printf("          frustum: bvh %8.4f ms  linear %8.4f ms  (%zu / %zu hits)\n",
+         t_query, t_qlin, nbvh, nlin);
+  printf("          ray:     bvh %8.4f ms  linear %8.4f ms  (%d / %d hits)\n",
+         t_pick, t_plin, hbvh, hlin);
+}
+
+int main ()
+{
+  srand(1);
+  for (int n : {1000, 10000, 100000})
+    Run(n);
+  return 0;
+}
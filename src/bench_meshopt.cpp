@@ -0,0 +1,126 @@
+// Mesh optimizer benchmark: ACMR/ATVR and GPU draw time of meshes in
+// file order against MeshOptimizer order.
+// Build with "make bench" and run build/bench_meshopt [file.msh ...];
+// without arguments, the Luxor meshes are used.
+
+#ifdef _WIN32
+#include <glad/gl.h>
+#elif __APPLE__
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+
+#include "mshparser.h"
+#include "meshoptimizer.h"
+#include "geometry.h"
+#include "state.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#define NDRAWS 100
+
+static const char* s_vsh =
+  "#version 410\n"
+  "layout(location=0) in vec4 coord;\n"
+  "uniform vec3 center;\n"
+  "uniform float scale;\n"
+  "void main() { gl_Position = vec4((coord.xyz-center)*scale,1.0); }\n";
+static const char* s_fsh =
+  "#version 410\n"
+  "out vec4 color;\n"
+  "void main() { color = vec4(1.0); }\n";
+
+static GLuint Compile (GLenum type, const char* src)
+{
+  GLuint id = glCreateShader(type);
+  glShaderSource(id,1,&src,nullptr);
+  glCompileShader(id);
+  return id;
+}
+
+// GPU time of NDRAWS draws, in ms per draw
+static double DrawTime (StatePtr st, GeometryPtr geom)
+{
+  GLuint query;
+  glGenQueries(1,&query);
+  geom->Draw(st);   // warm up
+  glFinish();
+  glBeginQuery(GL_TIME_ELAPSED,query);
+  for (int i=0; i<NDRAWS; ++i)
+    geom->Draw(st);
+  glEndQuery(GL_TIME_ELAPSED);
+  GLuint64 ns = 0;
+  glGetQueryObjectui64v(query,GL_QUERY_RESULT,&ns);
+  glDeleteQueries(1,&query);
+  return ns/1.0e6/NDRAWS;
+}
+
+int main (int argc, char* argv[])
+{
+  std::vector<std::string> files;
+  for (int i=1; i<argc; ++i)
+    files.push_back(argv[i]);
+  if (files.empty())
+    for (const char* name : {"base_a","base_b","haste1","haste2","haste3_a","haste3_b",
+                             "cupula_a","cupula_b","lampada"})
+      files.push_back(std::string("luxor/") + name + ".msh");
+
+  glfwInit();
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR,4);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR,1);
+  glfwWindowHint(GLFW_OPENGL_PROFILE,GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT,GL_TRUE);
+#endif
+  glfwWindowHint(GLFW_VISIBLE,GLFW_FALSE);
+  GLFWwindow* win = glfwCreateWindow(512,512,"bench",nullptr,nullptr);
+  if (!win) {
+    printf("Could not create GL context\n");
+    return 1;
+  }
+  glfwMakeContextCurrent(win);
+#ifdef _WIN32
+  gladLoadGL(glfwGetProcAddress);
+#elif !defined(__APPLE__)
+  glewExperimental = GL_TRUE;
+  glewInit();
+  while (glGetError() != GL_NO_ERROR) {}
+#endif
+  StatePtr st = State::Make(nullptr);   // binds program 0
+  GLuint pid = glCreateProgram();
+  glAttachShader(pid,Compile(GL_VERTEX_SHADER,s_vsh));
+  glAttachShader(pid,Compile(GL_FRAGMENT_SHADER,s_fsh));
+  glLinkProgram(pid);
+  glUseProgram(pid);
+  glEnable(GL_DEPTH_TEST);
+
+  printf("%-26s %9s %15s %15s %21s\n","mesh","tris","ACMR","ATVR","draw (ms)");
+  for (const std::string& file : files) {
+    MshParserPtr parser = MshParser::Make(file);
+    std::vector<Geometry::Vertex> verts(parser->GetVertexCount());
+    std::vector<unsigned int> indices(3*parser->GetTriangleCount());
+    Bounds box = parser->Parse(verts.data(),indices.data());
+    std::vector<Geometry::Vertex> opt_verts = verts;
+    std::vector<unsigned int> opt_indices = indices;
+    MeshOptimizer::Stats stats = MeshOptimizer::Optimize(opt_verts,opt_indices);
+    GeometryPtr before = Geometry::Make("",verts,indices);
+    GeometryPtr after = Geometry::Make("",opt_verts,opt_indices);
+    glm::vec3 c = box.GetCenter();
+    glUniform3f(glGetUniformLocation(pid,"center"),c.x,c.y,c.z);
+    glUniform1f(glGetUniformLocation(pid,"scale"),box.IsEmpty() ? 1.0f : 0.9f/box.GetRadius());
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    double t_before = DrawTime(st,before);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    double t_after = DrawTime(st,after);
+    printf("%-26s %9u %6.3f -> %5.3f %6.3f -> %5.3f %8.4f -> %8.4f\n",
+           file.c_str(), parser->GetTriangleCount(), stats.acmr_before, stats.acmr_after,
+           stats.atvr_before, stats.atvr_after, t_before, t_after);
+  }
+  glfwTerminate();
+  return 0;
+}
@@ -0,0 +1,162 @@
+// Mipmap benchmark: CPU mip chains (Image, box and Kaiser, one thread and
+// all threads) against glGenerateMipmap, for the images in images/ and
+// textures/ (or the files given). Build with "make bench" and run
+// build/bench_mips [files] from the repository root; needs a GL context.
+
+#include "image.h"
+
+#ifdef _WIN32
+#include <glad/gl.h>
+#elif __APPLE__
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#define RUNS 5
+
+static double Now ()
+{
+  using namespace std::chrono;
+  return duration<double,std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+static GLenum Format (const Image& img)
+{
+  return img.GetNChannels()==3 ? GL_RGB : GL_RGBA;
+}
+
+// base level upload, then mipmaps on the GPU
+static double GenerateMipmap (const ImagePtr& img)
+{
+  GLuint tex;
+  glGenTextures(1,&tex);
+  glBindTexture(GL_TEXTURE_2D,tex);
+  glTexImage2D(GL_TEXTURE_2D,0,Format(*img),img->GetWidth(),img->GetHeight(),0,
+               Format(*img),GL_UNSIGNED_BYTE,img->GetData());
+  glFinish();
+  double t = Now();
+  glGenerateMipmap(GL_TEXTURE_2D);
+  glFinish();
+  t = Now()-t;
+  glDeleteTextures(1,&tex);
+  return t;
+}
+
+// every level built on the CPU, then uploaded
+static double UploadChain (const std::vector<ImagePtr>& levels)
+{
+  GLuint tex;
+  glGenTextures(1,&tex);
+  glBindTexture(GL_TEXTURE_2D,tex);
+  glFinish();
+  double t = Now();
+  for (size_t l=0; l<levels.size(); ++l)
+    glTexImage2D(GL_TEXTURE_2D,GLint(l),Format(*levels[l]),levels[l]->GetWidth(),
+                 levels[l]->GetHeight(),0,Format(*levels[l]),GL_UNSIGNED_BYTE,
+                 levels[l]->GetData());
+  glFinish();
+  t = Now()-t;
+  glDeleteTextures(1,&tex);
+  return t;
+}
+
+// formats stb_image reads
+static bool Decodable (const std::string& ext)
+{
+  for (const char* e : {".jpg", ".jpeg", ".png", ".bmp", ".tga", ".gif", ".psd", ".hdr", ".pnm"})
+    if (ext == e)
+      return true;
+  return false;
+}
+
+// best of RUNS
+template <typename F>
+static double Best (F f)
+{
+  double best = 1e30;
+  for (int i=0; i<RUNS; ++i) {
+    double t = f();
+    if (t < best)
+      best = t;
+  }
+  return best;
+}
+
+int main (int argc, char* argv[])
+{
+  std::vector<std::string> files;
+  for (int i=1; i<argc; ++i)
+    files.push_back(argv[i]);
+  if (files.empty()) {
+    for (const char* dir : {"images", "textures"}) {
+      std::error_code ec;
+      for (const auto& entry : std::filesystem::directory_iterator(dir,ec))
+        if (entry.is_regular_file() && Decodable(entry.path().extension().string()))
+          files.push_back(entry.path().string());
+    }
+  }
+  if (files.empty()) {
+    fprintf(stderr,"No images found\n");
+    return 1;
+  }
+
+  // hidden window, for the context only
+  glfwInit();
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR,4);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR,1);
+  glfwWindowHint(GLFW_OPENGL_PROFILE,GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT,GL_TRUE);
+#endif
+  glfwWindowHint(GLFW_VISIBLE,GLFW_FALSE);
+  GLFWwindow* win = glfwCreateWindow(64,64,"bench_mips",nullptr,nullptr);
+  if (!win) {
+    fprintf(stderr,"Could not create a GL context\n");
+    return 1;
+  }
+  glfwMakeContextCurrent(win);
+#ifdef _WIN32
+  gladLoadGL(glfwGetProcAddress);
+#elif !defined(__APPLE__)
+  glewExperimental = GL_TRUE;
+  glewInit();
+  while (glGetError() != GL_NO_ERROR) {}
+#endif
+  glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+
+  printf("%-28s %11s %9s %9s %9s %9s %9s %9s\n","image","size","glGenMip",
+         "box(1)","box","kaiser(1)","kaiser","upload");
+  for (const std::string& file : files) {
+    ImagePtr img = Image::Make(file);
+    double t_gl = Best([&] () { return GenerateMipmap(img); });
+    double t_cpu[2][2];
+    std::vector<ImagePtr> levels;
+    Image::FILTER filters[2] = {Image::BOX, Image::KAISER};
+    for (int f=0; f<2; ++f)
+      for (int nthreads : {1, 0})
+        t_cpu[f][nthreads ? 0 : 1] = Best([&] () {
+          double t = Now();
+          levels = Image::MakeMipChain(img,filters[f],nthreads);
+          return Now()-t;
+        });
+    // levels of the last run (Kaiser, all threads)
+    double t_upload = Best([&] () { return UploadChain(levels); });
+    std::string size = std::to_string(img->GetWidth()) + "x" + std::to_string(img->GetHeight()) +
+                       "x" + std::to_string(img->GetNChannels());
+    printf("%-28s %11s %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f\n",file.c_str(),size.c_str(),
+           t_gl,t_cpu[0][0],t_cpu[0][1],t_cpu[1][0],t_cpu[1][1],t_upload);
+  }
+  printf("times in ms (best of %d); (1): one thread; upload: all CPU levels\n",RUNS);
+  glfwDestroyWindow(win);
+  glfwTerminate();
+  return 0;
+}
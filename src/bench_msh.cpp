@@ -0,0 +1,128 @@
+// .msh loading benchmark: stream based reader against MshParser.
+// Build with "make bench" and run build/bench_msh [file.msh];
+// without a file, a synthetic mesh is written to a temporary file.
+
+#include "mshparser.h"
+#include "geometry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static double Now ()
+{
+  using namespace std::chrono;
+  return duration<double,std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+// former Mesh reader
+static void ReadStream (const std::string& filename, std::vector<float>& coords,
+                        std::vector<float>& normals, std::vector<unsigned int>& indices)
+{
+  std::fstream fp;
+  fp.open(filename,std::ios::in);
+  if (!fp) {
+    std::cerr << "Could not open file: " << filename << std::endl;
+    exit(1);
+  }
+  while (!fp.eof()) {
+    char c;
+    float x, y, z;
+    unsigned int i, j, k;
+    fp >> c;
+    switch (c) {
+      case 'V':
+        fp >> x >> y >> z;
+        coords.push_back(x);
+        coords.push_back(y);
+        coords.push_back(z);
+      break;
+      case 'N':
+        fp >> x >> y >> z;
+        normals.push_back(x);
+        normals.push_back(y);
+        normals.push_back(z);
+      break;
+      case 'T':
+        fp >> i >> j >> k;
+        indices.push_back(i);
+        indices.push_back(j);
+        indices.push_back(k);
+      break;
+    }
+  }
+}
+
+// sphere tessellated as an n x n grid
+static void WriteSphere (const std::string& filename, int n)
+{
+  FILE* fp = fopen(filename.c_str(),"w");
+  if (!fp) {
+    std::cerr << "Could not create file: " << filename << std::endl;
+    exit(1);
+  }
+  for (int j=0; j<=n; ++j)
+    for (int i=0; i<=n; ++i) {
+      float theta = 6.2831853f*i/n, phi = 3.1415927f*j/n;
+      fprintf(fp,"V %f %f %f\n",sinf(theta)*sinf(phi),cosf(phi),cosf(theta)*sinf(phi));
+    }
+  for (int j=0; j<=n; ++j)
+    for (int i=0; i<=n; ++i) {
+      float theta = 6.2831853f*i/n, phi = 3.1415927f*j/n;
+      fprintf(fp,"N %f %f %f\n",sinf(theta)*sinf(phi),cosf(phi),cosf(theta)*sinf(phi));
+    }
+  for (int j=0; j<n; ++j)
+    for (int i=0; i<n; ++i) {
+      unsigned int a = j*(n+1)+i, b = a+1, c = a+n+2, d = a+n+1;
+      fprintf(fp,"T %u %u %u\nT %u %u %u\n",a,b,c,a,c,d);
+    }
+  fclose(fp);
+}
+
+int main (int argc, char* argv[])
+{
+  std::string filename = argc > 1 ? argv[1] : "bench_msh_tmp.msh";
+  if (argc <= 1)
+    WriteSphere(filename,1000);
+
+  double t = Now();
+  std::vector<float> coords, normals;
+  std::vector<unsigned int> indices;
+  ReadStream(filename,coords,normals,indices);
+  double t_stream = Now()-t;
+
+  MshParserPtr parser;
+  std::vector<Geometry::Vertex> verts;
+  std::vector<unsigned int> tris;
+  double mb = 0.0;
+  for (int nthreads : {1, 0}) {
+    t = Now();
+    parser = MshParser::Make(filename,nthreads);
+    verts.resize(parser->GetVertexCount());
+    tris.resize(3*parser->GetTriangleCount());
+    parser->Parse(verts.data(),tris.data());
+    double t_parse = Now()-t;
+    mb = parser->GetFileSize()/(1024.0*1024.0);
+    printf("MshParser (%s): %8.1f ms  %7.1f MB/s\n",
+           nthreads ? "1 thread " : "all threads", t_parse, mb/(t_parse/1000.0));
+  }
+  printf("stream reader:         %8.1f ms  %7.1f MB/s\n", t_stream, mb/(t_stream/1000.0));
+
+  // check both readers agree (the stream reader repeats the last record
+  // as a null triangle when the file ends with white space)
+  bool same = verts.size() == coords.size()/3 && tris.size() <= indices.size() &&
+              std::equal(tris.begin(),tris.end(),indices.begin());
+  for (size_t i=0; same && i<verts.size(); ++i)
+    same = verts[i].coord.x == coords[3*i] && verts[i].coord.y == coords[3*i+1] &&
+           verts[i].coord.z == coords[3*i+2];
+  printf("%u vertices, %u triangles, %.1f MB: results %s\n",
+         parser->GetVertexCount(), parser->GetTriangleCount(), mb, same ? "match" : "DIFFER");
+  if (argc <= 1)
+    remove(filename.c_str());
+  return same ? 0 : 1;
+}
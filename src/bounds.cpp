@@ -0,0 +1,75 @@
+#include "bounds.h"
+
+#include <cfloat>
+#include <cmath>
+
+Bounds::Bounds ()
+: m_min(FLT_MAX,FLT_MAX,FLT_MAX),
+  m_max(-FLT_MAX,-FLT_MAX,-FLT_MAX)
+{
+}
+
+Bounds::Bounds (const glm::vec3& min, const glm::vec3& max)
+: m_min(min),
+  m_max(max)
+{
+}
+
+bool Bounds::IsEmpty () const
+{
+  return m_min.x > m_max.x || m_min.y > m_max.y || m_min.z > m_max.z;
+}
+
+const glm::vec3& Bounds::GetMin () const
+{
+  return m_min;
+}
+
+const glm::vec3& Bounds::GetMax () const
+{
+  return m_max;
+}
+
+glm::vec3 Bounds::GetCenter () const
+{
+  return 0.5f*(m_min+m_max);
+}
+
+glm::vec3 Bounds::GetExtent () const
+{
+  return 0.5f*(m_max-m_min);
+}
+
+float Bounds::GetRadius () const
+{
+  return glm::length(GetExtent());
+}
+
+void Bounds::Merge (const glm::vec3& p)
+{
+  m_min = glm::min(m_min,p);
+  m_max = glm::max(m_max,p);
+}
+
+void Bounds::Merge (const Bounds& b)
+{
+  if (b.IsEmpty())
+    return;
+  m_min = glm::min(m_min,b.m_min);
+  m_max = glm::max(m_max,b.m_max);
+}
+
+// Box enclosing the transformed box (Arvo): transform the center and
+// accumulate the extent along the absolute value of the linear part
+Bounds Bounds::Transformed (const glm::mat4& mat) const
+{
+  if (IsEmpty())
+    return Bounds();
+  glm::vec3 c = glm::vec3(mat * glm::vec4(GetCenter(),1.0f));
+  glm::vec3 e = GetExtent();
+  glm::vec3 ext(0.0f);
+  for (int j=0; j<3; ++j)
+    for (int i=0; i<3; ++i)
+      ext[i] += std::fabs(mat[j][i]) * e[j];
+  return Bounds(c-ext,c+ext);
+}
@@ -0,0 +1,24 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm.hpp>
+
+// Axis-aligned bounding box (value type); an empty box has min > max
+class Bounds {
+  glm::vec3 m_min;
+  glm::vec3 m_max;
+public:
+  Bounds ();
+  Bounds (const glm::vec3& min, const glm::vec3& max);
+  bool IsEmpty () const;
+  const glm::vec3& GetMin () const;
+  const glm::vec3& GetMax () const;
+  glm::vec3 GetCenter () const;
+  glm::vec3 GetExtent () const;    // half size
+  float GetRadius () const;        // radius of the enclosing sphere (at center)
+  void Merge (const glm::vec3& p);
+  void Merge (const Bounds& b);
+  Bounds Transformed (const glm::mat4& mat) const;
+};
+
+#endif
@@ -0,0 +1,279 @@
+#include "bvh.h"
+#include "node.h"
+#include "shape.h"
+
+#include <algorithm>
+#include <cfloat>
+
+#define LEAF_SIZE 4   // always split above this many items
+#define MAX_LEAF 16   // never keep more than this in a leaf
+#define NBINS 12      // SAH bins per split
+#define MAX_DEPTH 48  // deeper nodes use median splits (bounds the query stack)
+#define STACK_SIZE 128
+
+static void CollectNodes (Node* node, std::vector<Node*>& nodes)
+{
+  if (!node->GetShapes().empty())
+    nodes.push_back(node);
+  for (const NodePtr& child : node->GetNodes())
+    CollectNodes(child.get(),nodes);
+}
+
+BVHPtr BVH::Make (NodePtr root)
+{
+  std::vector<Node*> nodes;
+  CollectNodes(root.get(),nodes);
+  BVHPtr bvh(new BVH(nodes));
+  bvh->m_root = root;   // keep the graph alive
+  return bvh;
+}
+
+BVHPtr BVH::Make (const std::vector<Node*>& nodes)
+{
+  return BVHPtr(new BVH(nodes));
+}
+
+BVH::BVH (const std::vector<Node*>& nodes)
+: m_root(nullptr)
+{
+  m_items.resize(nodes.size());
+  for (size_t i=0; i<nodes.size(); ++i)
+    m_items[i].node = nodes[i];
+  Build();
+}
+
+BVH::~BVH ()
+{
+}
+
+Bounds BVH::GetNodeBounds (Node* node)
+{
+  Bounds b;
+  const glm::mat4& mat = node->GetModelMatrix();
+  for (const ShapePtr& shp : node->GetShapes())
+    b.Merge(shp->GetBounds().Transformed(mat));
+  return b;
+}
+
+static float Area (const Bounds& b)
+{
+  if (b.IsEmpty())
+    return 0.0f;
+  glm::vec3 d = b.GetMax() - b.GetMin();
+  return 2.0f*(d.x*d.y + d.y*d.z + d.z*d.x);
+}
+
+void BVH::Build ()
+{
+  for (Item& item : m_items) {
+    item.bounds = GetNodeBounds(item.node);
+    item.centroid = item.bounds.IsEmpty() ? glm::vec3(0.0f) : item.bounds.GetCenter();
+  }
+  m_order.resize(m_items.size());
+  for (unsigned int i=0; i<m_order.size(); ++i)
+    m_order[i] = i;
+  m_tree.clear();
+  if (m_items.empty())
+    return;
+  m_tree.reserve(2*m_items.size());
+  BuildNode(0,(unsigned int)m_items.size(),0);
+}
+
+unsigned int BVH::BuildNode (unsigned int first, unsigned int count, int depth)
+{
+  unsigned int id = (unsigned int)m_tree.size();
+  m_tree.push_back(TreeNode{Bounds(),first,count,0});
+  Bounds bounds, cbounds;   // node and centroid bounds
+  for (unsigned int i=first; i<first+count; ++i) {
+    bounds.Merge(m_items[m_order[i]].bounds);
+    cbounds.Merge(m_items[m_order[i]].centroid);
+  }
+  m_tree[id].bounds = bounds;
+  if (count <= LEAF_SIZE)
+    return id;
+  // split along the largest centroid extent
+  glm::vec3 ext = cbounds.GetMax() - cbounds.GetMin();
+  int axis = (ext.x > ext.y && ext.x > ext.z) ? 0 : (ext.y > ext.z ? 1 : 2);
+  if (ext[axis] <= 0.0f) {
+    if (count <= MAX_LEAF)
+      return id;
+  }
+  unsigned int mid = first + count/2;
+  if (ext[axis] > 0.0f && depth < MAX_DEPTH) {
+    // binned SAH
+    float cmin = cbounds.GetMin()[axis];
+    float scale = NBINS / ext[axis];
+    unsigned int bcount[NBINS] = {0};
+    Bounds bbounds[NBINS];
+    for (unsigned int i=first; i<first+count; ++i) {
+      const Item& item = m_items[m_order[i]];
+      int b = std::min(NBINS-1,int((item.centroid[axis]-cmin)*scale));
+      bcount[b]++;
+      bbounds[b].Merge(item.bounds);
+    }
+    // sweep from the right to get suffix areas
+    float rarea[NBINS];
+    unsigned int rcount[NBINS];
+    Bounds acc;
+    unsigned int n = 0;
+    for (int b=NBINS-1; b>0; --b) {
+      acc.Merge(bbounds[b]);
+      n += bcount[b];
+      rarea[b] = Area(acc);
+      rcount[b] = n;
+    }
+    float best = FLT_MAX;
+    int split = -1;
+    acc = Bounds();
+    n = 0;
+    for (int b=0; b<NBINS-1; ++b) {
+      acc.Merge(bbounds[b]);
+      n += bcount[b];
+      if (n == 0 || rcount[b+1] == 0)
+        continue;
+      float cost = Area(acc)*n + rarea[b+1]*rcount[b+1];
+      if (cost < best) {
+        best = cost;
+        split = b;
+      }
+    }
+    float leafcost = Area(bounds)*count;
+    if (count <= MAX_LEAF && (split < 0 || best >= leafcost))
+      return id;
+    if (split >= 0) {
+      auto it = std::partition(m_order.begin()+first,m_order.begin()+first+count,
+        [&](unsigned int i) {
+          return std::min(NBINS-1,int((m_items[i].centroid[axis]-cmin)*scale)) <= split;
+        });
+      mid = (unsigned int)(it - m_order.begin());
+    }
+  }
+  if (mid == first || mid == first+count) {
+    // degenerate partition: median split
+    mid = first + count/2;
+    std::nth_element(m_order.begin()+first,m_order.begin()+mid,m_order.begin()+first+count,
+      [&](unsigned int a, unsigned int b) {
+        return m_items[a].centroid[axis] < m_items[b].centroid[axis];
+      });
+  }
+  m_tree[id].count = 0;
+  BuildNode(first,mid-first,depth+1);
+  unsigned int right = BuildNode(mid,first+count-mid,depth+1);
+  m_tree[id].right = right;
+  return id;
+}
+
+void BVH::Refit ()
+{
+  for (Item& item : m_items)
+    item.bounds = GetNodeBounds(item.node);
+  // children are stored after their parents
+  for (size_t i=m_tree.size(); i>0; --i) {
+    TreeNode& tn = m_tree[i-1];
+    tn.bounds = Bounds();
+    if (tn.count > 0) {
+      for (unsigned int j=tn.first; j<tn.first+tn.count; ++j)
+        tn.bounds.Merge(m_items[m_order[j]].bounds);
+    }
+    else {
+      tn.bounds.Merge(m_tree[i].bounds);
+      tn.bounds.Merge(m_tree[tn.right].bounds);
+    }
+  }
+}
+
+unsigned int BVH::GetItemCount () const
+{
+  return (unsigned int)m_items.size();
+}
+
+unsigned int BVH::GetTreeSize () const
+{
+  return (unsigned int)m_tree.size();
+}
+
+Node* BVH::GetItemNode (unsigned int item) const
+{
+  return m_items[item].node;
+}
+
+void BVH::Query (const Frustum& frustum, std::vector<unsigned int>& items) const
+{
+  if (m_tree.empty())
+    return;
+  unsigned int stack[STACK_SIZE];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    unsigned int id = stack[--top];
+    const TreeNode& tn = m_tree[id];
+    if (!frustum.Intersects(tn.bounds))
+      continue;
+    if (tn.count > 0) {
+      for (unsigned int j=tn.first; j<tn.first+tn.count; ++j) {
+        unsigned int i = m_order[j];
+        if (tn.count == 1 || frustum.Intersects(m_items[i].bounds))
+          items.push_back(i);
+      }
+    }
+    else {
+      stack[top++] = tn.right;
+      stack[top++] = id+1;
+    }
+  }
+}
+
+// slab test; returns the entry parameter in tnear
+static bool IntersectRay (const Bounds& b, const glm::vec3& o, const glm::vec3& inv, float tmax, float* tnear)
+{
+  if (b.IsEmpty())
+    return false;
+  float t0 = 0.0f, t1 = tmax;
+  for (int k=0; k<3; ++k) {
+    float ta = (b.GetMin()[k]-o[k])*inv[k];
+    float tb = (b.GetMax()[k]-o[k])*inv[k];
+    if (ta > tb)
+      std::swap(ta,tb);
+    t0 = std::max(t0,ta);
+    t1 = std::min(t1,tb);
+    if (t0 > t1)
+      return false;
+  }
+  *tnear = t0;
+  return true;
+}
+
+int BVH::Pick (const glm::vec3& origin, const glm::vec3& dir, float* t) const
+{
+  if (m_tree.empty())
+    return -1;
+  glm::vec3 inv(1.0f/dir.x,1.0f/dir.y,1.0f/dir.z);
+  float best = FLT_MAX;
+  int hit = -1;
+  unsigned int stack[STACK_SIZE];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    unsigned int id = stack[--top];
+    const TreeNode& tn = m_tree[id];
+    float tnear;
+    if (!IntersectRay(tn.bounds,origin,inv,best,&tnear))
+      continue;
+    if (tn.count > 0) {
+      for (unsigned int j=tn.first; j<tn.first+tn.count; ++j) {
+        unsigned int i = m_order[j];
+        if (IntersectRay(m_items[i].bounds,origin,inv,best,&tnear)) {
+          best = tnear;
+          hit = int(i);
+        }
+      }
+    }
+    else {
+      stack[top++] = tn.right;
+      stack[top++] = id+1;
+    }
+  }
+  if (t && hit >= 0)
+    *t = best;
+  return hit;
+}
@@ -0,0 +1,52 @@
+#include <memory>
+class BVH;
+using BVHPtr = std::shared_ptr<BVH>; 
+
+#ifndef BVH_H
+#define BVH_H
+
+#include "node.h"
+#include "bounds.h"
+#include "frustum.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+// Bounding volume hierarchy over the scene nodes that hold shapes.
+// Build uses binned SAH (static content); Refit only updates the boxes
+// of the existing tree (animated content).
+class BVH {
+  struct Item {
+    Node* node;
+    Bounds bounds;     // world bounds of the node's own shapes
+    glm::vec3 centroid;
+  };
+  struct TreeNode {
+    Bounds bounds;
+    unsigned int first;   // leaf: first entry in m_order
+    unsigned int count;   // leaf: number of items (0 for inner nodes)
+    unsigned int right;   // inner: right child (left child follows the node)
+  };
+  NodePtr m_root;
+  std::vector<Item> m_items;
+  std::vector<unsigned int> m_order;   // item indices, grouped by leaf
+  std::vector<TreeNode> m_tree;
+protected:
+  BVH (const std::vector<Node*>& nodes);
+  unsigned int BuildNode (unsigned int first, unsigned int count, int depth);
+public:
+  static BVHPtr Make (NodePtr root);
+  static BVHPtr Make (const std::vector<Node*>& nodes);
+  virtual ~BVH ();
+  static Bounds GetNodeBounds (Node* node);
+  void Build ();
+  void Refit ();
+  unsigned int GetItemCount () const;
+  unsigned int GetTreeSize () const;
+  Node* GetItemNode (unsigned int item) const;
+  // collect indices of items intersecting the frustum
+  void Query (const Frustum& frustum, std::vector<unsigned int>& items) const;
+  // closest item whose box is hit by the ray (or -1); t is the hit parameter
+  int Pick (const glm::vec3& origin, const glm::vec3& dir, float* t=nullptr) const;
+};
+
+#endif
@@ -127,5 +127,5 @@ void Camera3D::Load (StatePtr st) const
     glm::mat4 mat = glm::inverse(GetViewMatrix());
     cpos = mat * cpos;
   }
-  shd->SetUniform("cpos",cpos);
+  shd->SetUniform(shd->GetUniformLocation(Shader::CPOS),cpos);
 }
@@ -1,9 +1,9 @@
 #include "cone.h"
-#include "grid.h"
+#include "geometry.h"
 
+#include <algorithm>
 #include <cmath>
 #include <vector>
-#include <glm/gtc/matrix_transform.hpp>
 
 #ifdef _WIN32
 #include <glad/gl.h>
@@ -20,86 +20,94 @@ ConePtr Cone::Make (int nstack, int nslice, bool cap)
   return ConePtr(new Cone(nstack,nslice,cap));
 }
 
-Cone::Cone (int nstack, int nslice, bool cap)
+// Registered geometry of one tessellation
+static GeometryPtr Build (int nstack, int nslice, bool cap)
 {
-  GridPtr grid = Grid::Make(nstack,nslice);
-  int vcount = grid->VertexCount();
-
-  std::vector<float> coord(3*vcount);
-  std::vector<float> normal(3*vcount);
-
-  const float* texcoord = grid->GetCoords();
-  for (int vi=0; vi<vcount; ++vi) {
-    float u = texcoord[2*vi+0];
-    float v = texcoord[2*vi+1];
-    float theta = u * 2.0f * PI;
-    float y = v - 0.5f;     // from -0.5 (base) to +0.5 (apex)
-    float r = 1.0f - v;     // radius decreases linearly to apex
-    float s = sinf(theta);
-    float c = cosf(theta);
-    coord[3*vi+0] = r * s;  // x
-    coord[3*vi+1] = y;      // y
-    coord[3*vi+2] = r * c;  // z
-    // side normal for a right cone (H=1, R=1): n ~ (s,1,c)
-    float nx = s;
-    float ny = 1.0f;
-    float nz = c;
-    float invlen = 1.0f / sqrtf(nx*nx + ny*ny + nz*nz);
-    normal[3*vi+0] = nx * invlen;
-    normal[3*vi+1] = ny * invlen;
-    normal[3*vi+2] = nz * invlen;
+  std::string key = "cone:" + std::to_string(nstack) + "x" + std::to_string(nslice)
+                  + (cap ? ":cap" : "");
+  GeometryPtr geom = Geometry::Find(key);
+  if (!geom && Geometry::IsProcedural())
+    geom = Geometry::MakeProcedural(key,Geometry::PROC_CONE,nstack,nslice,cap ? 1 : 0);
+  if (!geom) {
+    GridPtr grid = Geometry::GetGrid(nstack,nslice);
+    int vcount = grid->VertexCount();
+    std::vector<Geometry::Vertex> verts(vcount);
+    const float* texcoord = grid->GetCoords();
+    for (int vi=0; vi<vcount; ++vi) {
+      float u = texcoord[2*vi+0];
+      float v = texcoord[2*vi+1];
+      float theta = u * 2.0f * PI;
+      float y = v - 0.5f;     // from -0.5 (base) to +0.5 (apex)
+      float r = 1.0f - v;     // radius decreases linearly to apex
+      float s = sinf(theta);
+      float c = cosf(theta);
+      verts[vi].coord = glm::vec3(r*s,y,r*c);
+      // side normal for a right cone (H=1, R=1): n ~ (s,1,c)
+      verts[vi].normal = glm::normalize(glm::vec3(s,1.0f,c));
+      verts[vi].tangent = glm::vec3(c,0.0f,-s);
+      verts[vi].texcoord = glm::vec2(u,v);
+    }
+    if (cap) {
+      // bake the base cap after the side, to be drawn in a single call
+      std::vector<unsigned int> indices(grid->GetIndices(),grid->GetIndices()+grid->IndexCount());
+      Geometry::AppendCap(verts,indices,nstack,-0.5f,false);
+      geom = Geometry::Make(key,verts,indices);
+    }
+    else
+      geom = Geometry::Make(key,verts,nstack,nslice);
   }
+  return geom;
+}
 
-  m_nind = (unsigned int)grid->IndexCount();
+Cone::Cone (int nstack, int nslice, bool cap)
+{
+  int nlevels = GetTessellationLevels(nstack);
+  for (int l=0; l<nlevels; ++l) {
+    m_levels.push_back(Build(nstack >> l,std::max(nslice >> l,1),cap));
+    m_segments.push_back(nstack >> l);
+  }
+}
 
-  // create VAO
-  glGenVertexArrays(1,&m_vao);
-  glBindVertexArray(m_vao);
+Cone::~Cone ()
+{
+}
 
-  // create buffers: coord, normal, texcoord
-  GLuint id[3];
-  glGenBuffers(3,id);
+void Cone::Draw (StatePtr st)
+{
+  DrawLOD(st,SelectLOD(st));
+}
 
-  glBindBuffer(GL_ARRAY_BUFFER,id[0]);
-  glBufferData(GL_ARRAY_BUFFER,GLsizeiptr(coord.size()*sizeof(float)),coord.data(),GL_STATIC_DRAW);
-  glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,0,0);
-  glEnableVertexAttribArray(0);
+bool Cone::CanDrawInstanced () const
+{
+  return true;
+}
 
-  glBindBuffer(GL_ARRAY_BUFFER,id[1]);
-  glBufferData(GL_ARRAY_BUFFER,GLsizeiptr(normal.size()*sizeof(float)),normal.data(),GL_STATIC_DRAW);
-  glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,0,0);
-  glEnableVertexAttribArray(1);
+void Cone::DrawInstanced (StatePtr st, int ninstances)
+{
+  m_levels[0]->DrawInstanced(st,ninstances);
+}
 
-  glBindBuffer(GL_ARRAY_BUFFER,id[2]);
-  glBufferData(GL_ARRAY_BUFFER,GLsizeiptr(2*vcount*sizeof(float)),texcoord,GL_STATIC_DRAW);
-  glVertexAttribPointer(3,2,GL_FLOAT,GL_FALSE,0,0);
-  glEnableVertexAttribArray(3);
+int Cone::GetLODCount () const
+{
+  return (int)m_levels.size();
+}
 
-  // create index buffer
-  GLuint index;
-  glGenBuffers(1,&index);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,index);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER,GLsizeiptr(m_nind*sizeof(unsigned int)),grid->GetIndices(),GL_STATIC_DRAW);
+float Cone::GetLODLimit (int level) const
+{
+  return GetTessellationLimit(m_segments[level],1.0f);
+}
 
-  m_basedisk = cap ? Disk::Make(nstack) : nullptr;
+void Cone::DrawLOD (StatePtr st, int level)
+{
+  m_levels[level]->Draw(st);
 }
 
-Cone::~Cone ()
+void Cone::DrawInstancedLOD (StatePtr st, int ninstances, int level)
 {
+  m_levels[level]->DrawInstanced(st,ninstances);
 }
 
-void Cone::Draw (StatePtr st)
+Bounds Cone::GetBounds () const
 {
-  glBindVertexArray(m_vao);
-  glDrawElements(GL_TRIANGLES,m_nind,GL_UNSIGNED_INT,0);
-  if (m_basedisk) {
-    // base cap at y=-0.5 (normal -Y)
-    st->PushMatrix();
-    glm::mat4 M = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f,-0.5f,0.0f))
-                * glm::rotate(glm::mat4(1.0f),  PI*0.5f, glm::vec3(1.0f,0.0f,0.0f));
-    st->MultMatrix(M);
-    st->LoadMatrices();
-    m_basedisk->Draw(st);
-    st->PopMatrix();
-  }
+  return Bounds(glm::vec3(-1.0f,-0.5f,-1.0f),glm::vec3(1.0f,0.5f,1.0f));
 }
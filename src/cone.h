@@ -6,18 +6,26 @@ using ConePtr = std::shared_ptr<Cone>;
 #define CONE_H
 
 #include "shape.h"
-#include "disk.h"
+#include "geometry.h"
+#include <vector>
 
 class Cone : public Shape {
-  unsigned int m_vao;
-  unsigned int m_nind; // number of indices (side)
-  DiskPtr m_basedisk;  // optional base cap
+  // precomputed levels of the side and optional base cap, halved from the requested tessellation
+  std::vector<GeometryPtr> m_levels;
+  std::vector<int> m_segments;   // segments around, per level
 protected:
   Cone (int nstack, int nslice, bool cap);
 public:
   static ConePtr Make (int nstack=64, int nslice=64, bool cap=true);
   virtual ~Cone ();
   virtual void Draw (StatePtr st);
+  virtual Bounds GetBounds () const;
+  virtual bool CanDrawInstanced () const;
+  virtual void DrawInstanced (StatePtr st, int ninstances);
+  virtual int GetLODCount () const;
+  virtual float GetLODLimit (int level) const;
+  virtual void DrawLOD (StatePtr st, int level);
+  virtual void DrawInstancedLOD (StatePtr st, int ninstances, int level);
 };
 
 #endif
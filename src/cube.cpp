@@ -1,6 +1,8 @@
 #include "cube.h"
 #include "error.h"
 
+#include <vector>
+
 #ifdef _WIN32
 //#define GLAD_GL_IMPLEMENTATION // Necessary for headeronly version.
 #include <glad/gl.h>
@@ -17,6 +19,9 @@ CubePtr Cube::Make ()
 
 Cube::Cube ()
 {
+  m_geom = Geometry::Find("cube");
+  if (m_geom)
+    return;
   float coords[] = { 
     // back face: counter clockwise 
     -0.5f, 0.0f,-0.5f,
@@ -153,44 +158,36 @@ Cube::Cube ()
     16,17,18,16,18,19,
     20,21,22,20,22,23
   };
-  // create VAO
-  glGenVertexArrays(1,&m_vao);
-  glBindVertexArray(m_vao);
-  // create coord buffer
-  GLuint id[4];   // buffers: coord, normal, tangent, texcoord
-  glGenBuffers(4,id);
-  glBindBuffer(GL_ARRAY_BUFFER,id[0]);
-  glBufferData(GL_ARRAY_BUFFER,sizeof(coords),coords,GL_STATIC_DRAW);
-  glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,0,0);
-  glEnableVertexAttribArray(0);
-  // create normal buffer
-  glBindBuffer(GL_ARRAY_BUFFER,id[1]);
-  glBufferData(GL_ARRAY_BUFFER,sizeof(normals),normals,GL_STATIC_DRAW);
-  glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,0,0);
-  glEnableVertexAttribArray(1);
-  // create tangent buffer
-  glBindBuffer(GL_ARRAY_BUFFER,id[2]);
-  glBufferData(GL_ARRAY_BUFFER,sizeof(tangents),tangents,GL_STATIC_DRAW);
-  glVertexAttribPointer(2,3,GL_FLOAT,GL_FALSE,0,0);
-  glEnableVertexAttribArray(2);
-  // create tex coord buffer
-  glBindBuffer(GL_ARRAY_BUFFER,id[3]);
-  glBufferData(GL_ARRAY_BUFFER,sizeof(normals),texcoords,GL_STATIC_DRAW);
-  glVertexAttribPointer(3,2,GL_FLOAT,GL_FALSE,0,0);
-  glEnableVertexAttribArray(3);
-  // create index buffer
-  GLuint index;
-  glGenBuffers(1,&index);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,index);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER,sizeof(indices),indices,GL_STATIC_DRAW);
+  std::vector<Geometry::Vertex> verts(24);
+  for (int i=0; i<24; ++i) {
+    verts[i].coord = glm::vec3(coords[3*i+0],coords[3*i+1],coords[3*i+2]);
+    verts[i].normal = glm::vec3(normals[3*i+0],normals[3*i+1],normals[3*i+2]);
+    verts[i].tangent = glm::vec3(tangents[3*i+0],tangents[3*i+1],tangents[3*i+2]);
+    verts[i].texcoord = glm::vec2(texcoords[2*i+0],texcoords[2*i+1]);
+  }
+  m_geom = Geometry::Make("cube",verts,std::vector<unsigned int>(indices,indices+36));
 }
 
 Cube::~Cube () 
 {
 }
 
-void Cube::Draw (StatePtr )
+void Cube::Draw (StatePtr st)
+{
+  m_geom->Draw(st);
+}
+
+bool Cube::CanDrawInstanced () const
 {
-  glBindVertexArray(m_vao);
-  glDrawElements(GL_TRIANGLES,36,GL_UNSIGNED_INT,0);
-}
\ No newline at end of file
+  return true;
+}
+
+void Cube::DrawInstanced (StatePtr st, int ninstances)
+{
+  m_geom->DrawInstanced(st,ninstances);
+}
+
+Bounds Cube::GetBounds () const
+{
+  return Bounds(glm::vec3(-0.5f,0.0f,-0.5f),glm::vec3(0.5f,1.0f,0.5f));
+}
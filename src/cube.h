@@ -6,14 +6,18 @@ using CubePtr = std::shared_ptr<Cube>;
 #define CUBE_H
 
 #include "shape.h"
+#include "geometry.h"
 
 class Cube : public Shape {
-  unsigned int m_vao;
+  GeometryPtr m_geom;
 protected:
   Cube ();
 public:
   static CubePtr Make ();
   virtual ~Cube ();
   virtual void Draw (StatePtr st);
+  virtual Bounds GetBounds () const;
+  virtual bool CanDrawInstanced () const;
+  virtual void DrawInstanced (StatePtr st, int ninstances);
 };
 #endif
\ No newline at end of file
@@ -1,9 +1,9 @@
 #include "cylinder.h"
-#include "grid.h"
+#include "geometry.h"
 
+#include <algorithm>
 #include <cmath>
 #include <vector>
-#include <glm/gtc/matrix_transform.hpp>
 
 #ifdef _WIN32
 #include <glad/gl.h>
@@ -20,88 +20,93 @@ CylinderPtr Cylinder::Make (int nstack, int nslice, bool caps)
   return CylinderPtr(new Cylinder(nstack,nslice,caps));
 }
 
-Cylinder::Cylinder (int nstack, int nslice, bool caps)
+// Registered geometry of one tessellation
+static GeometryPtr Build (int nstack, int nslice, bool caps)
 {
-  (void)caps; 
-  GridPtr grid = Grid::Make(nstack,nslice);
-  int vcount_side = grid->VertexCount();
-
-  std::vector<float> coord(3*vcount_side);
-  std::vector<float> normal(3*vcount_side);
-
-  const float* texcoord_side = grid->GetCoords();
-  for (int vi=0; vi<vcount_side; ++vi) {
-    float u = texcoord_side[2*vi+0];
-    float v = texcoord_side[2*vi+1];
-    float theta = u * 2.0f * PI;
-    float y = v - 0.5f;
-    float s = sinf(theta);
-    float c = cosf(theta);
-    coord[3*vi+0] = s; // x
-    coord[3*vi+1] = y; // y
-    coord[3*vi+2] = c; // z
-    normal[3*vi+0] = s;
-    normal[3*vi+1] = 0.0f;
-    normal[3*vi+2] = c;
+  std::string key = "cylinder:" + std::to_string(nstack) + "x" + std::to_string(nslice)
+                  + (caps ? ":caps" : "");
+  GeometryPtr geom = Geometry::Find(key);
+  if (!geom && Geometry::IsProcedural())
+    geom = Geometry::MakeProcedural(key,Geometry::PROC_CYLINDER,nstack,nslice,caps ? 2 : 0);
+  if (!geom) {
+    GridPtr grid = Geometry::GetGrid(nstack,nslice);
+    int vcount_side = grid->VertexCount();
+    std::vector<Geometry::Vertex> verts(vcount_side);
+    const float* texcoord_side = grid->GetCoords();
+    for (int vi=0; vi<vcount_side; ++vi) {
+      float u = texcoord_side[2*vi+0];
+      float v = texcoord_side[2*vi+1];
+      float theta = u * 2.0f * PI;
+      float y = v - 0.5f;
+      float s = sinf(theta);
+      float c = cosf(theta);
+      verts[vi].coord = glm::vec3(s,y,c);
+      verts[vi].normal = glm::vec3(s,0.0f,c);
+      verts[vi].tangent = glm::vec3(c,0.0f,-s);
+      verts[vi].texcoord = glm::vec2(u,v);
+    }
+    if (caps) {
+      // bake both caps after the side, to be drawn in a single call
+      std::vector<unsigned int> indices(grid->GetIndices(),grid->GetIndices()+grid->IndexCount());
+      Geometry::AppendCap(verts,indices,nstack,0.5f,true);
+      Geometry::AppendCap(verts,indices,nstack,-0.5f,false);
+      geom = Geometry::Make(key,verts,indices);
+    }
+    else
+      geom = Geometry::Make(key,verts,nstack,nslice);
   }
+  return geom;
+}
 
-  // Use grid indices directly
-  m_nind = (unsigned int)grid->IndexCount();
+Cylinder::Cylinder (int nstack, int nslice, bool caps)
+{
+  int nlevels = GetTessellationLevels(nstack);
+  for (int l=0; l<nlevels; ++l) {
+    m_levels.push_back(Build(nstack >> l,std::max(nslice >> l,1),caps));
+    m_segments.push_back(nstack >> l);
+  }
+}
 
-  // create VAO
-  glGenVertexArrays(1,&m_vao);
-  glBindVertexArray(m_vao);
+Cylinder::~Cylinder ()
+{
+}
 
-  // create buffers: coord, normal, texcoord
-  GLuint id[3];
-  glGenBuffers(3,id);
+void Cylinder::Draw (StatePtr st)
+{
+  DrawLOD(st,SelectLOD(st));
+}
 
-  glBindBuffer(GL_ARRAY_BUFFER,id[0]);
-  glBufferData(GL_ARRAY_BUFFER,GLsizeiptr(coord.size()*sizeof(float)),coord.data(),GL_STATIC_DRAW);
-  glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,0,0);
-  glEnableVertexAttribArray(0);
+bool Cylinder::CanDrawInstanced () const
+{
+  return true;
+}
 
-  glBindBuffer(GL_ARRAY_BUFFER,id[1]);
-  glBufferData(GL_ARRAY_BUFFER,GLsizeiptr(normal.size()*sizeof(float)),normal.data(),GL_STATIC_DRAW);
-  glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,0,0);
-  glEnableVertexAttribArray(1);
+void Cylinder::DrawInstanced (StatePtr st, int ninstances)
+{
+  m_levels[0]->DrawInstanced(st,ninstances);
+}
 
-  glBindBuffer(GL_ARRAY_BUFFER,id[2]);
-  // use texcoords directly from Grid (matches friend's example style)
-  glBufferData(GL_ARRAY_BUFFER,GLsizeiptr(2*vcount_side*sizeof(float)),texcoord_side,GL_STATIC_DRAW);
-  glVertexAttribPointer(3,2,GL_FLOAT,GL_FALSE,0,0);
-  glEnableVertexAttribArray(3);
+int Cylinder::GetLODCount () const
+{
+  return (int)m_levels.size();
+}
 
-  // create index buffer
-  GLuint index;
-  glGenBuffers(1,&index);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,index);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER,GLsizeiptr(m_nind*sizeof(unsigned int)),grid->GetIndices(),GL_STATIC_DRAW);
+float Cylinder::GetLODLimit (int level) const
+{
+  return GetTessellationLimit(m_segments[level],1.0f);
+}
 
-  m_topdisk = Disk::Make(nstack);
-  m_botdisk = Disk::Make(nstack);
+void Cylinder::DrawLOD (StatePtr st, int level)
+{
+  m_levels[level]->Draw(st);
 }
 
-Cylinder::~Cylinder ()
+void Cylinder::DrawInstancedLOD (StatePtr st, int ninstances, int level)
 {
+  m_levels[level]->DrawInstanced(st,ninstances);
 }
 
-void Cylinder::Draw (StatePtr st)
+Bounds Cylinder::GetBounds () const
 {
-  glBindVertexArray(m_vao);
-  glDrawElements(GL_TRIANGLES,m_nind,GL_UNSIGNED_INT,0);
-  // top cap (+Y)
-  st->PushMatrix();
-  glm::mat4 Mtop = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.5f, 0.0f)) * glm::rotate(glm::mat4(1.0f), -PI*0.5f, glm::vec3(1.0f,0.0f,0.0f));
-  st->MultMatrix(Mtop);
-  st->LoadMatrices();
-  m_topdisk->Draw(st);
-  st->PopMatrix();
-  // bottom cap (-Y)
-  st->PushMatrix();
-  glm::mat4 Mbot = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f,-0.5f, 0.0f)) * glm::rotate(glm::mat4(1.0f),  PI*0.5f, glm::vec3(1.0f,0.0f,0.0f));
-  st->MultMatrix(Mbot);
-  st->LoadMatrices();
-  m_botdisk->Draw(st);
-  st->PopMatrix();
+  return Bounds(glm::vec3(-1.0f,-0.5f,-1.0f),glm::vec3(1.0f,0.5f,1.0f));
 }
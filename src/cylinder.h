@@ -6,20 +6,26 @@ using CylinderPtr = std::shared_ptr<Cylinder>;
 #define CYLINDER_H
 
 #include "shape.h"
-#include "disk.h"
+#include "geometry.h"
+#include <vector>
 
 class Cylinder : public Shape {
-  unsigned int m_vao;
-  unsigned int m_nind; // number of indices
-  // optional caps as separate Disk shapes (drawn with local transforms)
-  DiskPtr m_topdisk;
-  DiskPtr m_botdisk;
+  // precomputed levels of the side and optional caps, halved from the requested tessellation
+  std::vector<GeometryPtr> m_levels;
+  std::vector<int> m_segments;   // segments around, per level
 protected:
   Cylinder (int nstack, int nslice, bool caps);
 public:
   static CylinderPtr Make (int nstack=64, int nslice=64, bool caps=false);
   virtual ~Cylinder ();
   virtual void Draw (StatePtr st);
+  virtual Bounds GetBounds () const;
+  virtual bool CanDrawInstanced () const;
+  virtual void DrawInstanced (StatePtr st, int ninstances);
+  virtual int GetLODCount () const;
+  virtual float GetLODLimit (int level) const;
+  virtual void DrawLOD (StatePtr st, int level);
+  virtual void DrawInstancedLOD (StatePtr st, int ninstances, int level);
 };
 
 #endif
@@ -6,9 +6,10 @@ using DiskPtr = std::shared_ptr<Disk>;
 #define DISK_H
 
 #include "shape.h"
+#include "geometry.h"
 
 class Disk : public Shape {
-  unsigned int m_vao;
+  GeometryPtr m_geom;
   int m_nslice;
 protected:
   Disk (int nslice);
@@ -16,5 +17,8 @@ public:
   static DiskPtr Make (int nslice=64);
   virtual ~Disk ();
   virtual void Draw (StatePtr st);
+  virtual Bounds GetBounds () const;
+  virtual bool CanDrawInstanced () const;
+  virtual void DrawInstanced (StatePtr st, int ninstances);
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,56 @@
+#include "frustum.h"
+
+#include <cmath>
+
+Frustum::Frustum ()
+{
+  for (int i=0; i<6; ++i)
+    m_planes[i] = glm::vec4(0.0f,0.0f,0.0f,1.0f);  // accept everything
+}
+
+Frustum::Frustum (const glm::mat4& m)
+{
+  // Gribb & Hartmann: combine the last row with each of the others
+  glm::vec4 row[4];
+  for (int i=0; i<4; ++i)
+    row[i] = glm::vec4(m[0][i],m[1][i],m[2][i],m[3][i]);
+  m_planes[0] = row[3] + row[0];  // left
+  m_planes[1] = row[3] - row[0];  // right
+  m_planes[2] = row[3] + row[1];  // bottom
+  m_planes[3] = row[3] - row[1];  // top
+  m_planes[4] = row[3] + row[2];  // near
+  m_planes[5] = row[3] - row[2];  // far
+  for (int i=0; i<6; ++i)
+    m_planes[i] /= glm::length(glm::vec3(m_planes[i]));
+}
+
+const glm::vec4& Frustum::GetPlane (int i) const
+{
+  return m_planes[i];
+}
+
+// Conservative box test: rejects when the box is fully behind one plane
+bool Frustum::Intersects (const Bounds& b) const
+{
+  if (b.IsEmpty())
+    return false;
+  glm::vec3 c = b.GetCenter();
+  glm::vec3 e = b.GetExtent();
+  for (int i=0; i<6; ++i) {
+    const glm::vec4& p = m_planes[i];
+    float r = e.x*std::fabs(p.x) + e.y*std::fabs(p.y) + e.z*std::fabs(p.z);
+    if (glm::dot(glm::vec3(p),c) + p.w < -r)
+      return false;
+  }
+  return true;
+}
+
+bool Frustum::Intersects (const glm::vec3& center, float radius) const
+{
+  for (int i=0; i<6; ++i) {
+    const glm::vec4& p = m_planes[i];
+    if (glm::dot(glm::vec3(p),center) + p.w < -radius)
+      return false;
+  }
+  return true;
+}
@@ -0,0 +1,19 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "bounds.h"
+#include <glm/glm.hpp>
+
+// View frustum as six planes (normals pointing inside), extracted from
+// a projection*view matrix
+class Frustum {
+  glm::vec4 m_planes[6];
+public:
+  Frustum ();
+  Frustum (const glm::mat4& projview);
+  const glm::vec4& GetPlane (int i) const;
+  bool Intersects (const Bounds& b) const;
+  bool Intersects (const glm::vec3& center, float radius) const;
+};
+
+#endif
@@ -0,0 +1,562 @@
+#include "geometry.h"
+#include "bounds.h"
+
+#ifdef _WIN32
+//#define GLAD_GL_IMPLEMENTATION // Necessary for headeronly version.
+#include <glad/gl.h>
+#elif __APPLE__
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <utility>
+
+#define MIN_VERTICES (64*1024)
+#define MIN_INDICES (256*1024)
+
+static_assert(sizeof(Geometry::Vertex) == 11*sizeof(float),"unexpected vertex padding");
+static_assert(sizeof(Geometry::CompactVertex) == 20,"unexpected compact vertex padding");
+
+// vertex/index buffers shared by all entries of a layout, grown by copy when full;
+// the index buffer holds 16 and 32-bit ranges, so it is sized in bytes
+struct GeometryArena {
+  GLuint vao = 0;
+  GLuint vbo = 0;
+  GLuint ibo = 0;
+  bool compact;
+  unsigned int vsize;                  // vertex size
+  unsigned int vcap = 0, vcount = 0;
+  size_t icap = 0, iused = 0;          // bytes
+  unsigned int icount = 0;
+  explicit GeometryArena (bool compact)
+  : compact(compact),
+    vsize(compact ? sizeof(Geometry::CompactVertex) : sizeof(Geometry::Vertex))
+  {
+  }
+};
+
+struct GridEntry {
+  GridPtr grid;
+  size_t first[2];        // index range in each arena (once uploaded)
+  bool uploaded[2];
+};
+
+static bool s_compact = false;
+static bool s_procedural = false;
+static GLuint s_empty_vao = 0;   // procedural draws read no attributes
+static GeometryArena s_arena(false);
+static GeometryArena s_compact_arena(true);
+static std::map<std::string,GeometryPtr> s_entries;
+static std::map<std::pair<int,int>,GridEntry> s_grids;
+
+static GeometryArena& GetArena (bool compact)
+{
+  return compact ? s_compact_arena : s_arena;
+}
+
+// compact and procedural entries are registered under their own keys
+static std::string EntryKey (const std::string& key)
+{
+  if (s_procedural)
+    return "procedural:" + key;
+  return s_compact ? "compact:" + key : key;
+}
+
+static GridEntry& FindGrid (int nx, int ny)
+{
+  GridEntry& e = s_grids[std::make_pair(nx,ny)];
+  if (!e.grid) {
+    e.grid = Grid::Make(nx,ny);
+    e.first[0] = e.first[1] = 0;
+    e.uploaded[0] = e.uploaded[1] = false;
+  }
+  return e;
+}
+
+// Copy a buffer into a larger one; returns the new buffer
+static GLuint Grow (GLuint old, size_t used, size_t size)
+{
+  GLuint id;
+  glGenBuffers(1,&id);
+  glBindBuffer(GL_COPY_WRITE_BUFFER,id);
+  glBufferData(GL_COPY_WRITE_BUFFER,size,nullptr,GL_STATIC_DRAW);
+  if (old) {
+    glBindBuffer(GL_COPY_READ_BUFFER,old);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER,GL_COPY_WRITE_BUFFER,0,0,used);
+    glDeleteBuffers(1,&old);
+  }
+  return id;
+}
+
+static void SetupVAO (GeometryArena& a)
+{
+  if (!a.vao)
+    glGenVertexArrays(1,&a.vao);
+  glBindVertexArray(a.vao);
+  glBindBuffer(GL_ARRAY_BUFFER,a.vbo);
+  GLsizei stride = a.vsize;
+  if (a.compact) {
+    // integers are converted unnormalized: the shader applies the scale
+    using CV = Geometry::CompactVertex;
+    glVertexAttribPointer(0,4,GL_SHORT,GL_FALSE,stride,(void*)offsetof(CV,coord));
+    glVertexAttribPointer(1,2,GL_SHORT,GL_FALSE,stride,(void*)offsetof(CV,normal));
+    glVertexAttribPointer(2,2,GL_SHORT,GL_FALSE,stride,(void*)offsetof(CV,tangent));
+    glVertexAttribPointer(3,2,GL_HALF_FLOAT,GL_FALSE,stride,(void*)offsetof(CV,texcoord));
+  }
+  else {
+    using V = Geometry::Vertex;
+    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,stride,(void*)offsetof(V,coord));
+    glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,stride,(void*)offsetof(V,normal));
+    glVertexAttribPointer(2,3,GL_FLOAT,GL_FALSE,stride,(void*)offsetof(V,tangent));
+    glVertexAttribPointer(3,2,GL_FLOAT,GL_FALSE,stride,(void*)offsetof(V,texcoord));
+  }
+  for (GLuint i=0; i<4; ++i)
+    glEnableVertexAttribArray(i);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,a.ibo);
+}
+
+static unsigned int ReserveVertices (GeometryArena& a, unsigned int n)
+{
+  if (a.vcount + n > a.vcap) {
+    unsigned int cap = a.vcap ? a.vcap : MIN_VERTICES;
+    while (cap < a.vcount + n)
+      cap *= 2;
+    a.vbo = Grow(a.vbo,size_t(a.vcount)*a.vsize,size_t(cap)*a.vsize);
+    a.vcap = cap;
+    SetupVAO(a);
+  }
+  unsigned int base = a.vcount;
+  a.vcount += n;
+  return base;
+}
+
+// returns the byte offset of n indices of the given size
+static size_t ReserveIndices (GeometryArena& a, unsigned int n, size_t size)
+{
+  size_t first = (a.iused + size - 1) / size * size;
+  if (first + n*size > a.icap) {
+    size_t cap = a.icap ? a.icap : MIN_INDICES*sizeof(unsigned int);
+    while (cap < first + n*size)
+      cap *= 2;
+    a.ibo = Grow(a.ibo,a.iused,cap);
+    a.icap = cap;
+    SetupVAO(a);
+  }
+  a.iused = first + n*size;
+  a.icount += n;
+  return first;
+}
+
+static unsigned int AppendVertices (GeometryArena& a, const void* verts, unsigned int n)
+{
+  unsigned int base = ReserveVertices(a,n);
+  glBindBuffer(GL_COPY_WRITE_BUFFER,a.vbo);
+  glBufferSubData(GL_COPY_WRITE_BUFFER,size_t(base)*a.vsize,size_t(n)*a.vsize,verts);
+  return base;
+}
+
+static size_t AppendIndices (GeometryArena& a, const void* indices, unsigned int n, size_t size)
+{
+  size_t first = ReserveIndices(a,n,size);
+  // not through GL_ELEMENT_ARRAY_BUFFER, which would alter the bound VAO
+  glBindBuffer(GL_COPY_WRITE_BUFFER,a.ibo);
+  glBufferSubData(GL_COPY_WRITE_BUFFER,first,n*size,indices);
+  return first;
+}
+
+static void Register (const std::string& key, GeometryPtr geom)
+{
+  if (!key.empty())
+    s_entries[EntryKey(key)] = geom;
+}
+
+// float to half, rounded to nearest; tiny values flush to zero
+static unsigned short FloatToHalf (float f)
+{
+  uint32_t x;
+  memcpy(&x,&f,sizeof(x));
+  uint32_t sign = (x >> 16) & 0x8000;
+  int exp = int((x >> 23) & 0xff) - 127 + 15;
+  uint32_t mant = x & 0x7fffff;
+  if (exp <= 0)
+    return (unsigned short)sign;
+  if (exp >= 31)
+    return (unsigned short)(sign | 0x7bff);   // largest finite
+  uint32_t h = sign | (uint32_t(exp) << 10) | (mant >> 13);
+  if (mant & 0x1000)
+    h++;   // a carry into the exponent is still correct
+  return (unsigned short)h;
+}
+
+static short ToShort (float x)
+{
+  return (short)std::lround(std::max(-1.0f,std::min(1.0f,x))*32767.0f);
+}
+
+// Octahedral mapping of a unit vector to [-1,1]^2
+static void OctEncode (const glm::vec3& n, short out[2])
+{
+  float sum = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+  float x = sum > 0.0f ? n.x/sum : 0.0f;
+  float y = sum > 0.0f ? n.y/sum : 0.0f;
+  if (n.z < 0.0f) {
+    float ox = x;
+    x = (1.0f - std::fabs(y)) * (ox >= 0.0f ? 1.0f : -1.0f);
+    y = (1.0f - std::fabs(ox)) * (y >= 0.0f ? 1.0f : -1.0f);
+  }
+  out[0] = ToShort(x);
+  out[1] = ToShort(y);
+}
+
+void Geometry::SetCompact (bool enabled)
+{
+  s_compact = enabled;
+}
+
+bool Geometry::IsCompact ()
+{
+  return s_compact;
+}
+
+void Geometry::SetProcedural (bool enabled)
+{
+  s_procedural = enabled;
+}
+
+bool Geometry::IsProcedural ()
+{
+  return s_procedural;
+}
+
+Geometry::CompactVertex Geometry::Compress (const Vertex& v, const glm::vec3& offset,
+                                            const glm::vec3& scale)
+{
+  CompactVertex c;
+  for (int k=0; k<3; ++k) {
+    float q = scale[k] > 0.0f ? (v.coord[k]-offset[k])/scale[k] : 0.0f;
+    c.coord[k] = (short)std::lround(std::max(-32767.0f,std::min(32767.0f,q)));
+  }
+  c.coord[3] = 1;
+  OctEncode(v.normal,c.normal);
+  OctEncode(v.tangent,c.tangent);
+  c.texcoord[0] = FloatToHalf(v.texcoord.x);
+  c.texcoord[1] = FloatToHalf(v.texcoord.y);
+  return c;
+}
+
+// Compress vertices over their bounds into the compact arena
+static unsigned int AppendCompact (const Geometry::Vertex* verts, unsigned int n,
+                                   glm::vec3* offset, glm::vec3* scale)
+{
+  Bounds b;
+  for (unsigned int i=0; i<n; ++i)
+    b.Merge(verts[i].coord);
+  *offset = n ? b.GetCenter() : glm::vec3(0.0f);
+  *scale = n ? b.GetExtent()/32767.0f : glm::vec3(0.0f);
+  std::vector<Geometry::CompactVertex> cverts(n);
+  for (unsigned int i=0; i<n; ++i)
+    cverts[i] = Geometry::Compress(verts[i],*offset,*scale);
+  return AppendVertices(s_compact_arena,cverts.data(),n);
+}
+
+GeometryPtr Geometry::Make (const std::string& key,
+                            const std::vector<Vertex>& verts,
+                            const std::vector<unsigned int>& indices)
+{
+  return Make(key,verts.data(),(unsigned int)verts.size(),
+              indices.data(),(unsigned int)indices.size());
+}
+
+GeometryPtr Geometry::Make (const std::string& key,
+                            const Vertex* verts, unsigned int nverts,
+                            const unsigned int* indices, unsigned int nindices)
+{
+  GeometryPtr geom;
+  if (!s_compact) {
+    unsigned int base = AppendVertices(s_arena,verts,nverts);
+    size_t first = AppendIndices(s_arena,indices,nindices,sizeof(unsigned int));
+    geom = GeometryPtr(new Geometry(false,base,first,nindices,GL_UNSIGNED_INT));
+  }
+  else {
+    glm::vec3 offset, scale;
+    unsigned int base = AppendCompact(verts,nverts,&offset,&scale);
+    size_t first;
+    GLenum type;
+    if (nverts <= 65536) {
+      std::vector<unsigned short> shorts(indices,indices+nindices);
+      first = AppendIndices(s_compact_arena,shorts.data(),nindices,sizeof(unsigned short));
+      type = GL_UNSIGNED_SHORT;
+    }
+    else {
+      first = AppendIndices(s_compact_arena,indices,nindices,sizeof(unsigned int));
+      type = GL_UNSIGNED_INT;
+    }
+    geom = GeometryPtr(new Geometry(true,base,first,nindices,type));
+    geom->m_qoffset = offset;
+    geom->m_qscale = scale;
+  }
+  Register(key,geom);
+  return geom;
+}
+
+GeometryPtr Geometry::Make (const std::string& key,
+                            const std::vector<Vertex>& verts,
+                            int nx, int ny)
+{
+  GridEntry& e = FindGrid(nx,ny);
+  GeometryArena& a = GetArena(s_compact);
+  // grids of up to 64K vertices use 16-bit indices in the compact arena
+  bool shorts = s_compact && e.grid->VertexCount() <= 65536;
+  if (!e.uploaded[s_compact]) {
+    const unsigned int* indices = e.grid->GetIndices();
+    unsigned int n = e.grid->IndexCount();
+    if (shorts) {
+      std::vector<unsigned short> tmp(indices,indices+n);
+      e.first[s_compact] = AppendIndices(a,tmp.data(),n,sizeof(unsigned short));
+    }
+    else
+      e.first[s_compact] = AppendIndices(a,indices,n,sizeof(unsigned int));
+    e.uploaded[s_compact] = true;
+  }
+  GLenum type = shorts ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+  GeometryPtr geom;
+  if (!s_compact) {
+    unsigned int base = AppendVertices(a,verts.data(),(unsigned int)verts.size());
+    geom = GeometryPtr(new Geometry(false,base,e.first[0],e.grid->IndexCount(),type));
+  }
+  else {
+    glm::vec3 offset, scale;
+    unsigned int base = AppendCompact(verts.data(),(unsigned int)verts.size(),&offset,&scale);
+    geom = GeometryPtr(new Geometry(true,base,e.first[1],e.grid->IndexCount(),type));
+    geom->m_qoffset = offset;
+    geom->m_qscale = scale;
+  }
+  Register(key,geom);
+  return geom;
+}
+
+GeometryPtr Geometry::MakeProcedural (const std::string& key, int shape, int nx, int ny,
+                                      int ncaps)
+{
+  unsigned int count = 6*nx*ny + 3*nx*ncaps;
+  GeometryPtr geom(new Geometry(false,0,0,count,GL_NONE));
+  geom->m_shape = shape;
+  geom->m_nx = nx;
+  geom->m_ny = ny;
+  Register(key,geom);
+  return geom;
+}
+
+GeometryPtr Geometry::Make (GeometryPtr vertices,
+                            const unsigned int* indices, unsigned int nindices)
+{
+  GeometryArena& a = GetArena(vertices->m_compact);
+  size_t first;
+  if (vertices->m_type == GL_UNSIGNED_SHORT) {
+    std::vector<unsigned short> shorts(indices,indices+nindices);
+    first = AppendIndices(a,shorts.data(),nindices,sizeof(unsigned short));
+  }
+  else
+    first = AppendIndices(a,indices,nindices,sizeof(unsigned int));
+  GeometryPtr geom(new Geometry(vertices->m_compact,vertices->m_base,first,nindices,
+                                vertices->m_type));
+  geom->m_qoffset = vertices->m_qoffset;
+  geom->m_qscale = vertices->m_qscale;
+  return geom;
+}
+
+GeometryPtr Geometry::MakeMapped (const std::string& key,
+                                  unsigned int nverts, unsigned int nindices,
+                                  Vertex** verts, unsigned int** indices)
+{
+  unsigned int base = ReserveVertices(s_arena,nverts);
+  size_t first = ReserveIndices(s_arena,nindices,sizeof(unsigned int));
+  GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+  glBindBuffer(GL_COPY_WRITE_BUFFER,s_arena.vbo);
+  *verts = static_cast<Vertex*>(glMapBufferRange(GL_COPY_WRITE_BUFFER,base*sizeof(Vertex),
+                                                 nverts*sizeof(Vertex),access));
+  glBindBuffer(GL_COPY_WRITE_BUFFER,s_arena.ibo);
+  *indices = static_cast<unsigned int*>(glMapBufferRange(GL_COPY_WRITE_BUFFER,first,
+                                                         nindices*sizeof(unsigned int),access));
+  GeometryPtr geom(new Geometry(false,base,first,nindices,GL_UNSIGNED_INT));
+  if (!key.empty())
+    s_entries[key] = geom;
+  return geom;
+}
+
+void Geometry::Unmap ()
+{
+  glBindBuffer(GL_COPY_WRITE_BUFFER,s_arena.vbo);
+  glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+  glBindBuffer(GL_COPY_WRITE_BUFFER,s_arena.ibo);
+  glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+}
+
+Geometry::Geometry (bool compact, unsigned int base, size_t offset, unsigned int count,
+                    unsigned int type)
+: m_compact(compact),
+  m_base(base),
+  m_offset(offset),
+  m_count(count),
+  m_type(type),
+  m_qoffset(0.0f),
+  m_qscale(1.0f),
+  m_shape(PROC_NONE),
+  m_nx(0),
+  m_ny(0)
+{
+}
+
+Geometry::~Geometry ()
+{
+}
+
+GeometryPtr Geometry::Find (const std::string& key)
+{
+  auto it = s_entries.find(EntryKey(key));
+  return it == s_entries.end() ? nullptr : it->second;
+}
+
+GridPtr Geometry::GetGrid (int nx, int ny)
+{
+  return FindGrid(nx,ny).grid;
+}
+
+// Same layout as Disk, rotated to the XZ plane
+void Geometry::AppendCap (std::vector<Vertex>& verts, std::vector<unsigned int>& indices,
+                          int nslice, float y, bool up)
+{
+  const float twoPi = 6.28318530718f;
+  unsigned int center = (unsigned int)verts.size();
+  float side = up ? -1.0f : 1.0f;   // keeps counter clockwise order seen from outside
+  Vertex v;
+  v.normal = glm::vec3(0.0f,up ? 1.0f : -1.0f,0.0f);
+  v.tangent = glm::vec3(1.0f,0.0f,0.0f);
+  v.coord = glm::vec3(0.0f,y,0.0f);
+  v.texcoord = glm::vec2(0.5f,0.5f);
+  verts.push_back(v);
+  for (int i=0; i<=nslice; ++i) {
+    float ang = twoPi * float(i) / float(nslice);
+    float x = std::cos(ang);
+    float z = std::sin(ang);
+    v.coord = glm::vec3(x,y,side*z);
+    v.texcoord = glm::vec2(0.5f+0.5f*x,0.5f+0.5f*z);
+    verts.push_back(v);
+  }
+  for (int i=0; i<nslice; ++i) {
+    indices.push_back(center);
+    indices.push_back(center+i+1);
+    indices.push_back(center+i+2);
+  }
+}
+
+unsigned int Geometry::GetEntryCount ()
+{
+  return (unsigned int)s_entries.size();
+}
+
+unsigned int Geometry::GetVertexCount ()
+{
+  return s_arena.vcount + s_compact_arena.vcount;
+}
+
+unsigned int Geometry::GetIndexCount ()
+{
+  return s_arena.icount + s_compact_arena.icount;
+}
+
+size_t Geometry::GetMemoryUsage ()
+{
+  return size_t(s_arena.vcount)*s_arena.vsize + s_arena.iused +
+         size_t(s_compact_arena.vcount)*s_compact_arena.vsize + s_compact_arena.iused;
+}
+
+unsigned int Geometry::GetBaseVertex () const
+{
+  return m_base;
+}
+
+unsigned int Geometry::GetFirstIndex () const
+{
+  return (unsigned int)(m_offset / (m_type == GL_UNSIGNED_SHORT ? 2 : 4));
+}
+
+unsigned int Geometry::GetCount () const
+{
+  return m_count;
+}
+
+bool Geometry::IsCompactEntry () const
+{
+  return m_compact;
+}
+
+static void DrawProcedural (StatePtr st, int shape, int nx, int ny,
+                            unsigned int count, int ninstances)
+{
+  if (!s_empty_vao)
+    glGenVertexArrays(1,&s_empty_vao);
+  st->BindVertexArray(s_empty_vao);
+  st->LoadProceduralShape(shape,nx,ny);
+  if (ninstances > 0)
+    glDrawArraysInstanced(GL_TRIANGLES,0,count,ninstances);
+  else
+    glDrawArrays(GL_TRIANGLES,0,count);
+}
+
+// Entries of a layout share the arena VAO, so the bind is elided by
+// State between consecutive draws
+void Geometry::Draw (StatePtr st) const
+{
+  if (m_shape != PROC_NONE) {
+    DrawProcedural(st,m_shape,m_nx,m_ny,m_count,0);
+    return;
+  }
+  st->BindVertexArray(GetArena(m_compact).vao);
+  st->LoadVertexDecode(m_compact,m_qoffset,m_qscale);
+  glDrawElementsBaseVertex(GL_TRIANGLES,m_count,m_type,(void*)m_offset,m_base);
+}
+
+void Geometry::DrawInstanced (StatePtr st, int ninstances) const
+{
+  if (m_shape != PROC_NONE) {
+    DrawProcedural(st,m_shape,m_nx,m_ny,m_count,ninstances);
+    return;
+  }
+  st->BindVertexArray(GetArena(m_compact).vao);
+  st->LoadVertexDecode(m_compact,m_qoffset,m_qscale);
+  glDrawElementsInstancedBaseVertex(GL_TRIANGLES,m_count,m_type,(void*)m_offset,
+                                    ninstances,m_base);
+}
+
+void Geometry::DrawRanges (StatePtr st, const unsigned int* first, const unsigned int* count,
+                           int nranges) const
+{
+  if (nranges <= 0)
+    return;
+  if (m_shape != PROC_NONE) {
+    Draw(st);
+    return;
+  }
+  // per-frame scratch for the GL arrays
+  ArenaPtr arena = st->GetArena();
+  GLsizei* counts = arena->Alloc<GLsizei>(nranges);
+  const void** offsets = arena->Alloc<const void*>(nranges);
+  GLint* bases = arena->Alloc<GLint>(nranges);
+  size_t isize = m_type == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+  for (int i=0; i<nranges; ++i) {
+    counts[i] = (GLsizei)count[i];
+    offsets[i] = (const void*)(m_offset + first[i]*isize);
+    bases[i] = (GLint)m_base;
+  }
+  st->BindVertexArray(GetArena(m_compact).vao);
+  st->LoadVertexDecode(m_compact,m_qoffset,m_qscale);
+  glMultiDrawElementsBaseVertex(GL_TRIANGLES,counts,m_type,offsets,nranges,bases);
+}
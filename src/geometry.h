@@ -0,0 +1,119 @@
+#include <memory>
+class Geometry;
+using GeometryPtr = std::shared_ptr<Geometry>; 
+
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include "state.h"
+#include "grid.h"
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Shared shape geometry. All entries are sub-allocated from a single
+// vertex/index arena with a common layout (coord, normal, tangent,
+// texcoord), so every draw uses the same VAO and only differs by its
+// offsets (base vertex and first index).
+// Entries are registered by primitive type and tessellation, e.g.
+// "sphere:64x64", so equal shapes share their data; index ranges of
+// grids are shared by all grid shapes with the same (nx,ny).
+// As for the other GL objects, the arena lives as long as the context.
+// Entries created in compact mode go to a second arena with a 20 byte
+// layout and 16-bit indices when they fit; the vertex shader decodes
+// them (see State::LoadVertexDecode). Procedural entries hold no data:
+// the vertex shader generates their grid from gl_VertexID.
+class Geometry {
+  bool m_compact;         // stored in the compact arena
+  unsigned int m_base;    // first vertex in the arena
+  size_t m_offset;        // first index, in bytes
+  unsigned int m_count;   // number of indices
+  unsigned int m_type;    // index type
+  glm::vec3 m_qoffset;    // coord dequantization (compact entries)
+  glm::vec3 m_qscale;
+  int m_shape;            // procedural shape (PROC_NONE: stored vertices)
+  int m_nx, m_ny;
+protected:
+  Geometry (bool compact, unsigned int base, size_t offset, unsigned int count,
+            unsigned int type);
+public:
+  // procedural shapes, as numbered in the vertex shaders
+  enum PROCEDURAL {
+    PROC_NONE=0,
+    PROC_QUAD,
+    PROC_SPHERE,
+    PROC_CYLINDER,
+    PROC_CONE
+  };
+  struct Vertex {
+    glm::vec3 coord;
+    glm::vec3 normal;
+    glm::vec3 tangent;
+    glm::vec2 texcoord;
+  };
+  // compact layout: coord as 16-bit integers over the entry bounds
+  // (w = 1), octahedral normal and tangent, half float texcoord
+  struct CompactVertex {
+    short coord[4];
+    short normal[2];
+    short tangent[2];
+    unsigned short texcoord[2];
+  };
+  // store new entries in the compact layout (default: disabled);
+  // compact entries are registered apart from float ones
+  static void SetCompact (bool enabled);
+  static bool IsCompact ();
+  // create grid shapes as procedural entries (default: disabled)
+  static void SetProcedural (bool enabled);
+  static bool IsProcedural ();
+  // coord = offset + scale*stored coord
+  static CompactVertex Compress (const Vertex& v, const glm::vec3& offset, const glm::vec3& scale);
+  // an empty key creates an entry that is not registered
+  static GeometryPtr Make (const std::string& key,
+                           const std::vector<Vertex>& verts,
+                           const std::vector<unsigned int>& indices);
+  static GeometryPtr Make (const std::string& key,
+                           const Vertex* verts, unsigned int nverts,
+                           const unsigned int* indices, unsigned int nindices);
+  // vertices laid out as an nx x ny grid, drawn with the shared grid indices
+  static GeometryPtr Make (const std::string& key,
+                           const std::vector<Vertex>& verts,
+                           int nx, int ny);
+  // procedural entry: an nx x ny grid of the shape, followed by ncaps
+  // disks of nx segments (cylinder: top then bottom; cone: base)
+  static GeometryPtr MakeProcedural (const std::string& key, int shape, int nx, int ny,
+                                     int ncaps=0);
+  // entry over the vertices of another one, e.g. a level of detail
+  static GeometryPtr Make (GeometryPtr vertices,
+                           const unsigned int* indices, unsigned int nindices);
+  // reserve an entry and map its storage, to be written by a loader;
+  // Unmap must be called before drawing (float layout only)
+  static GeometryPtr MakeMapped (const std::string& key,
+                                 unsigned int nverts, unsigned int nindices,
+                                 Vertex** verts, unsigned int** indices);
+  static void Unmap ();
+  virtual ~Geometry ();
+  // registered entry, or nullptr
+  static GeometryPtr Find (const std::string& key);
+  static GridPtr GetGrid (int nx, int ny);
+  // append a unit disk (cap) at height y, facing +Y (up) or -Y
+  static void AppendCap (std::vector<Vertex>& verts, std::vector<unsigned int>& indices,
+                         int nslice, float y, bool up);
+  // arena usage
+  static unsigned int GetEntryCount ();
+  static unsigned int GetVertexCount ();
+  static unsigned int GetIndexCount ();
+  static size_t GetMemoryUsage ();     // bytes used in both arenas
+  unsigned int GetBaseVertex () const;
+  unsigned int GetFirstIndex () const;
+  unsigned int GetCount () const;
+  bool IsCompactEntry () const;
+  void Draw (StatePtr st) const;
+  void DrawInstanced (StatePtr st, int ninstances) const;
+  // subranges of the indices (in indices, from the entry's first one),
+  // in a single multi-draw call
+  void DrawRanges (StatePtr st, const unsigned int* first, const unsigned int* count,
+                   int nranges) const;
+};
+
+#endif
@@ -3,10 +3,19 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define IMAGE_SSE2
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <thread>
 #include <vector>
 
 Image::Image (const std::string& filename)
@@ -39,14 +48,29 @@ Image::Image (const std::string& filename)
   }
 }
 
+Image::Image (int width, int height, int nchannels)
+: m_width(width),
+  m_height(height),
+  m_nchannels(nchannels),
+  m_pixels(size_t(width)*height*nchannels)
+{
+  m_data = m_pixels.data();
+}
+
 ImagePtr Image::Make (const std::string& filename)
 {
   return ImagePtr(new Image(filename));
 }
 
+ImagePtr Image::Make (int width, int height, int nchannels)
+{
+  return ImagePtr(new Image(width,height,nchannels));
+}
+
 Image::~Image ()
 {
-  stbi_image_free(m_data);
+  if (m_pixels.empty())
+    stbi_image_free(m_data);
 }
 
 const unsigned char* Image::GetData () const
@@ -54,6 +78,229 @@ const unsigned char* Image::GetData () const
   return m_data;
 }
 
+unsigned char* Image::GetData ()
+{
+  return m_data;
+}
+
+// destination pixels per thread, below which threads do not pay off
+#define MIN_CHUNK_PIXELS (64*1024)
+
+// Kaiser windowed sinc for 2x decimation: taps at 0.5, 1.5, 2.5, 3.5
+// source pixels from the destination pixel centre
+#define KAISER_ALPHA 4.0
+#define KAISER_TAPS 8
+
+static double BesselI0 (double x)
+{
+  double sum = 1.0, term = 1.0;
+  for (int k=1; k<32; ++k) {
+    term *= (x/(2.0*k))*(x/(2.0*k));
+    sum += term;
+  }
+  return sum;
+}
+
+struct KaiserWeights {
+  float w[KAISER_TAPS];
+  KaiserWeights ()
+  {
+    const double PI = 3.14159265358979;
+    double sum = 0.0;
+    for (int k=0; k<KAISER_TAPS; ++k) {
+      double d = std::fabs(k - (KAISER_TAPS/2 - 0.5));
+      double t = d/(KAISER_TAPS/2);
+      double sinc = std::sin(PI*d/2.0)/(PI*d/2.0);
+      w[k] = float(sinc*BesselI0(KAISER_ALPHA*std::sqrt(1.0-t*t))/BesselI0(KAISER_ALPHA));
+      sum += w[k];
+    }
+    for (int k=0; k<KAISER_TAPS; ++k)
+      w[k] = float(w[k]/sum);
+  }
+};
+
+// Destination rows [y0,y1); odd sizes repeat the last row/column
+void Image::BoxRows (Image* img, int y0, int y1) const
+{
+  int w = img->m_width, n = m_nchannels;
+  int rowsize = m_width*n;
+  std::vector<uint16_t> sum(rowsize);
+  for (int y=y0; y<y1; ++y) {
+    const unsigned char* r0 = m_data + size_t(std::min(2*y,m_height-1))*rowsize;
+    const unsigned char* r1 = m_data + size_t(std::min(2*y+1,m_height-1))*rowsize;
+    unsigned char* dst = img->m_data + size_t(y)*w*n;
+    // vertical pairs
+    int i = 0;
+#ifdef IMAGE_SSE2
+    __m128i zero = _mm_setzero_si128();
+    for (; i+16<=rowsize; i+=16) {
+      __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r0+i));
+      __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r1+i));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(&sum[i]),
+                       _mm_add_epi16(_mm_unpacklo_epi8(v0,zero),_mm_unpacklo_epi8(v1,zero)));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(&sum[i+8]),
+                       _mm_add_epi16(_mm_unpackhi_epi8(v0,zero),_mm_unpackhi_epi8(v1,zero)));
+    }
+#endif
+    for (; i<rowsize; ++i)
+      sum[i] = uint16_t(r0[i] + r1[i]);
+    // horizontal pairs
+    int x = 0;
+#ifdef IMAGE_SSE2
+    __m128i two = _mm_set1_epi16(2);
+    if (m_width > 1 && n == 4) {
+      // two destination pixels from four source pixels
+      for (; x+2<=w; x+=2) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&sum[8*x]));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&sum[8*x+8]));
+        __m128i s = _mm_add_epi16(_mm_unpacklo_epi64(a,b),_mm_unpackhi_epi64(a,b));
+        s = _mm_srli_epi16(_mm_add_epi16(s,two),2);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst+4*x),_mm_packus_epi16(s,s));
+      }
+    }
+    else if (m_width > 1 && n == 1) {
+      // eight destination pixels from sixteen source pixels
+      __m128i low = _mm_set1_epi32(0xffff);
+      for (; x+8<=w; x+=8) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&sum[2*x]));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&sum[2*x+8]));
+        a = _mm_add_epi32(_mm_and_si128(a,low),_mm_srli_epi32(a,16));
+        b = _mm_add_epi32(_mm_and_si128(b,low),_mm_srli_epi32(b,16));
+        __m128i s = _mm_srli_epi16(_mm_add_epi16(_mm_packs_epi32(a,b),two),2);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst+x),_mm_packus_epi16(s,s));
+      }
+    }
+#endif
+    for (; x<w; ++x) {
+      int x0 = std::min(2*x,m_width-1)*n, x1 = std::min(2*x+1,m_width-1)*n;
+      for (int c=0; c<n; ++c)
+        dst[x*n+c] = (unsigned char)((sum[x0+c] + sum[x1+c] + 2) >> 2);
+    }
+  }
+}
+
+// Destination rows [y0,y1): separable, each source column filtered
+// vertically into a float row, which is then filtered horizontally;
+// edges repeat
+void Image::KaiserRows (Image* img, int y0, int y1) const
+{
+  static const KaiserWeights kaiser;   // initialized once, thread safe
+  const float* weights = kaiser.w;
+  int w = img->m_width, n = m_nchannels;
+  int rowsize = m_width*n;
+  int pad = KAISER_TAPS/2 - 1;
+  int npad = std::max(m_width,2*w) + KAISER_TAPS;
+  std::vector<float> tmp(size_t(npad)*n);
+  for (int y=y0; y<y1; ++y) {
+    const unsigned char* taps[KAISER_TAPS];
+    for (int k=0; k<KAISER_TAPS; ++k) {
+      int sy = std::min(std::max(2*y-pad+k,0),m_height-1);
+      taps[k] = m_data + size_t(sy)*rowsize;
+    }
+    float* col = &tmp[pad*n];
+    int i = 0;
+#ifdef IMAGE_SSE2
+    __m128i zero = _mm_setzero_si128();
+    for (; i+16<=rowsize; i+=16) {
+      __m128 acc[4] = {_mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps()};
+      for (int k=0; k<KAISER_TAPS; ++k) {
+        __m128 wk = _mm_set1_ps(weights[k]);
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(taps[k]+i));
+        __m128i lo = _mm_unpacklo_epi8(v,zero), hi = _mm_unpackhi_epi8(v,zero);
+        __m128i q[4] = {_mm_unpacklo_epi16(lo,zero), _mm_unpackhi_epi16(lo,zero),
+                        _mm_unpacklo_epi16(hi,zero), _mm_unpackhi_epi16(hi,zero)};
+        for (int j=0; j<4; ++j)
+          acc[j] = _mm_add_ps(acc[j],_mm_mul_ps(wk,_mm_cvtepi32_ps(q[j])));
+      }
+      for (int j=0; j<4; ++j)
+        _mm_storeu_ps(col+i+4*j,acc[j]);
+    }
+#endif
+    for (; i<rowsize; ++i) {
+      float v = 0.0f;
+      for (int k=0; k<KAISER_TAPS; ++k)
+        v += weights[k]*taps[k][i];
+      col[i] = v;
+    }
+    for (int x=0; x<pad; ++x)
+      for (int c=0; c<n; ++c)
+        tmp[x*n+c] = col[c];
+    for (int x=pad+m_width; x<npad; ++x)
+      for (int c=0; c<n; ++c)
+        tmp[x*n+c] = col[(m_width-1)*n+c];
+    // horizontal: destination x is centred between source 2x and 2x+1
+    unsigned char* dst = img->m_data + size_t(y)*w*n;
+    int x = 0;
+#ifdef IMAGE_SSE2
+    if (n == 4) {
+      for (; x+2<=w; x+=2) {
+        __m128 a = _mm_setzero_ps(), b = _mm_setzero_ps();
+        for (int k=0; k<KAISER_TAPS; ++k) {
+          __m128 wk = _mm_set1_ps(weights[k]);
+          a = _mm_add_ps(a,_mm_mul_ps(wk,_mm_loadu_ps(&tmp[(2*x+k)*4])));
+          b = _mm_add_ps(b,_mm_mul_ps(wk,_mm_loadu_ps(&tmp[(2*x+2+k)*4])));
+        }
+        // rounded as the scalar path (+0.5, truncated), saturated to [0,255]
+        __m128 half = _mm_set1_ps(0.5f);
+        __m128i s = _mm_packs_epi32(_mm_cvttps_epi32(_mm_add_ps(a,half)),
+                                    _mm_cvttps_epi32(_mm_add_ps(b,half)));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst+4*x),_mm_packus_epi16(s,s));
+      }
+    }
+#endif
+    for (; x<w; ++x) {
+      const float* p = &tmp[2*x*n];
+      for (int c=0; c<n; ++c) {
+        float v = 0.0f;
+        for (int k=0; k<KAISER_TAPS; ++k)
+          v += weights[k]*p[k*n+c];
+        dst[x*n+c] = (unsigned char)std::min(255.0f,std::max(0.0f,v+0.5f));
+      }
+    }
+  }
+}
+
+ImagePtr Image::Downsample (FILTER filter, int nthreads) const
+{
+  int w = m_width > 1 ? m_width/2 : 1;
+  int h = m_height > 1 ? m_height/2 : 1;
+  ImagePtr img = Make(w,h,m_nchannels);
+  if (nthreads <= 0)
+    nthreads = int(std::thread::hardware_concurrency());
+  int nchunks = std::max(1,std::min(nthreads,int(size_t(w)*h/MIN_CHUNK_PIXELS)));
+  nchunks = std::min(nchunks,h);
+  auto rows = [this,filter,img,h,nchunks](int i) {
+    int y0 = h*i/nchunks, y1 = h*(i+1)/nchunks;
+    if (filter == KAISER)
+      KaiserRows(img.get(),y0,y1);
+    else
+      BoxRows(img.get(),y0,y1);
+  };
+  std::vector<std::thread> threads;
+  for (int i=1; i<nchunks; ++i)
+    threads.emplace_back(rows,i);
+  rows(0);
+  for (std::thread& t : threads)
+    t.join();
+  return img;
+}
+
+std::vector<ImagePtr> Image::MakeMipChain (ImagePtr img, FILTER filter, int nthreads)
+{
+  std::vector<ImagePtr> levels(1,img);
+  while (levels.back()->m_width > 1 || levels.back()->m_height > 1)
+    levels.push_back(levels.back()->Downsample(filter,nthreads));
+  return levels;
+}
+
+ImagePtr Image::Fit (ImagePtr img, int max_size, FILTER filter, int nthreads)
+{
+  max_size = std::max(max_size,1);
+  while (img->m_width > max_size || img->m_height > max_size)
+    img = img->Downsample(filter,nthreads);
+  return img;
+}
+
 int Image::GetWidth () const
 {
   return m_width;
@@ -6,21 +6,42 @@ using ImagePtr = std::shared_ptr<Image>;
 #define IMAGE_H
 
 #include <string>
+#include <vector>
 
 class Image {
+public:
+  enum FILTER {
+    BOX,      // 2x2 average, as glGenerateMipmap
+    KAISER    // 8x8 Kaiser windowed sinc: sharper, less aliasing
+  };
+private:
   int m_width;
   int m_height;
   int m_nchannels;
   unsigned char* m_data;
+  std::vector<unsigned char> m_pixels;   // owned data (decoded data belongs to stb)
+  void BoxRows (Image* dst, int y0, int y1) const;
+  void KaiserRows (Image* dst, int y0, int y1) const;
 protected:
   Image (const std::string& filename);
+  Image (int width, int height, int nchannels);
 public:
   static ImagePtr Make (const std::string& filename);
+  // uninitialized pixels
+  static ImagePtr Make (int width, int height, int nchannels);
   virtual ~Image ();
   int GetWidth () const;
   int GetHeight () const;
   int GetNChannels () const;
   const unsigned char* GetData () const;
+  unsigned char* GetData ();
+  // next mipmap level: half size (at least 1); rows are split among
+  // nthreads (0: all cores) when the image is large
+  ImagePtr Downsample (FILTER filter=BOX, int nthreads=0) const;
+  // img (level 0) and its mipmap levels down to 1x1
+  static std::vector<ImagePtr> MakeMipChain (ImagePtr img, FILTER filter=BOX, int nthreads=0);
+  // img halved until both sizes are at most max_size (img itself if it fits)
+  static ImagePtr Fit (ImagePtr img, int max_size, FILTER filter=KAISER, int nthreads=0);
   void ExtractSubimage (int x, int y, int w, int h, unsigned char* data);
 };
 
@@ -0,0 +1,204 @@
+#include "ktxfile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+
+static const unsigned char KTX_IDENTIFIER[12] = {
+  0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+};
+
+struct KtxHeader {
+  unsigned char identifier[12];
+  uint32_t endianness;
+  uint32_t gl_type;                 // 0: compressed
+  uint32_t gl_type_size;
+  uint32_t gl_format;               // 0: compressed
+  uint32_t gl_internal_format;
+  uint32_t gl_base_internal_format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+  uint32_t nelements;
+  uint32_t nfaces;
+  uint32_t nlevels;
+  uint32_t kv_bytes;                // key/value data that follows
+};
+
+#define SOURCE_KEY "source"
+
+// "<size> <modification time> <params>" of the source, or empty
+static std::string SourceInfo (const std::string& source, const std::string& params)
+{
+  std::error_code ec;
+  uintmax_t size = std::filesystem::file_size(source,ec);
+  if (ec)
+    return std::string();
+  auto time = std::filesystem::last_write_time(source,ec).time_since_epoch().count();
+  if (ec)
+    return std::string();
+  return std::to_string(size) + " " + std::to_string(time) + " " + params;
+}
+
+// base format of the compressed formats written by TexCompress
+static uint32_t BaseFormat (uint32_t format)
+{
+  switch (format) {
+    case 0x83F0: return 0x1907;   // DXT1 (BC1): RGB
+    case 0x8DBD: return 0x8227;   // RGTC2 (BC5): RG
+    default: return 0x1908;       // RGBA
+  }
+}
+
+std::string KtxFile::GetCacheName (const std::string& source)
+{
+  return source + ".ktx";
+}
+
+KtxFilePtr KtxFile::Open (const std::string& source, const std::string& params)
+{
+  std::string name = GetCacheName(source);
+  std::error_code ec;
+  if (!std::filesystem::exists(name,ec))
+    return nullptr;
+  std::string info = SourceInfo(source,params);
+  if (info.empty())
+    return nullptr;
+  MappedFilePtr file = MappedFile::Make(name);
+  if (file->GetSize() < sizeof(KtxHeader))
+    return nullptr;
+  const KtxHeader* h = reinterpret_cast<const KtxHeader*>(file->GetData());
+  if (memcmp(h->identifier,KTX_IDENTIFIER,12) != 0 || h->endianness != 0x04030201 ||
+      h->gl_type != 0 || h->depth != 0 || h->nfaces != 1 || h->nelements != 0 ||
+      h->nlevels == 0 || sizeof(KtxHeader) + size_t(h->kv_bytes) > file->GetSize())
+    return nullptr;
+  // the source entry has to match
+  const char* kv = file->GetData() + sizeof(KtxHeader);
+  std::string expected = std::string(SOURCE_KEY) + '\0' + info + '\0';
+  if (h->kv_bytes < 4 + expected.size())
+    return nullptr;
+  uint32_t kv_size;
+  memcpy(&kv_size,kv,4);
+  if (kv_size != expected.size() || memcmp(kv+4,expected.data(),expected.size()) != 0)
+    return nullptr;
+  KtxFilePtr ktx(new KtxFile(file));
+  if (ktx->GetLevelCount() != int(h->nlevels))
+    return nullptr;
+  return ktx;
+}
+
+bool KtxFile::Write (const std::string& source, const std::string& params,
+                     uint32_t format, int width, int height,
+                     const std::vector<std::vector<unsigned char>>& levels)
+{
+  std::string info = SourceInfo(source,params);
+  if (info.empty() || levels.empty())
+    return false;
+  std::string entry = std::string(SOURCE_KEY) + '\0' + info + '\0';
+  uint32_t entry_size = (uint32_t)entry.size();
+  uint32_t pad = (4 - entry_size%4)%4;
+  KtxHeader h;
+  memset(&h,0,sizeof(h));
+  memcpy(h.identifier,KTX_IDENTIFIER,12);
+  h.endianness = 0x04030201;
+  h.gl_type_size = 1;
+  h.gl_internal_format = format;
+  h.gl_base_internal_format = BaseFormat(format);
+  h.width = width;
+  h.height = height;
+  h.nfaces = 1;
+  h.nlevels = (uint32_t)levels.size();
+  h.kv_bytes = 4 + entry_size + pad;
+  // write to a temporary file, renamed when complete
+  std::string name = GetCacheName(source);
+  std::string tmp = MappedFile::GetTempName(name);
+  FILE* fp = fopen(tmp.c_str(),"wb");
+  if (!fp)
+    return false;
+  const char zeros[4] = {0, 0, 0, 0};
+  bool ok = fwrite(&h,sizeof(h),1,fp) == 1 &&
+            fwrite(&entry_size,4,1,fp) == 1 &&
+            fwrite(entry.data(),1,entry_size,fp) == entry_size &&
+            fwrite(zeros,1,pad,fp) == pad;
+  for (size_t i=0; ok && i<levels.size(); ++i) {
+    uint32_t size = (uint32_t)levels[i].size();
+    uint32_t lpad = (4 - size%4)%4;
+    ok = fwrite(&size,4,1,fp) == 1 &&
+         fwrite(levels[i].data(),1,size,fp) == size &&
+         fwrite(zeros,1,lpad,fp) == lpad;
+  }
+  ok = fclose(fp) == 0 && ok;
+  std::error_code ec;
+  if (ok)
+    std::filesystem::rename(tmp,name,ec);
+  if (!ok || ec) {
+    std::filesystem::remove(tmp,ec);
+    std::cerr << "Could not write texture cache: " << name << std::endl;
+    return false;
+  }
+  return true;
+}
+
+KtxFile::KtxFile (MappedFilePtr file)
+: m_file(file)
+{
+  const KtxHeader* h = reinterpret_cast<const KtxHeader*>(m_file->GetData());
+  m_format = h->gl_internal_format;
+  m_width = int(h->width);
+  m_height = int(h->height);
+  // levels follow the key/value data; a truncated file keeps fewer levels
+  size_t offset = sizeof(KtxHeader) + h->kv_bytes;
+  for (uint32_t i=0; i<h->nlevels && offset+4 <= m_file->GetSize(); ++i) {
+    uint32_t size;
+    memcpy(&size,m_file->GetData()+offset,4);
+    if (offset + 4 + size > m_file->GetSize())
+      break;
+    m_offsets.push_back(offset+4);
+    m_sizes.push_back(size);
+    offset += 4 + size + (4 - size%4)%4;
+  }
+}
+
+KtxFile::~KtxFile ()
+{
+}
+
+uint32_t KtxFile::GetFormat () const
+{
+  return m_format;
+}
+
+int KtxFile::GetWidth () const
+{
+  return m_width;
+}
+
+int KtxFile::GetHeight () const
+{
+  return m_height;
+}
+
+int KtxFile::GetLevelCount () const
+{
+  return (int)m_offsets.size();
+}
+
+const unsigned char* KtxFile::GetLevelData (int level) const
+{
+  return reinterpret_cast<const unsigned char*>(m_file->GetData() + m_offsets[level]);
+}
+
+uint32_t KtxFile::GetLevelSize (int level) const
+{
+  return m_sizes[level];
+}
+
+size_t KtxFile::GetDataSize () const
+{
+  size_t size = 0;
+  for (uint32_t s : m_sizes)
+    size += s;
+  return size;
+}
@@ -0,0 +1,45 @@
+#include <memory>
+class KtxFile;
+using KtxFilePtr = std::shared_ptr<KtxFile>;
+
+#ifndef KTX_FILE_H
+#define KTX_FILE_H
+
+#include "mappedfile.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Compressed texture sidecar of an image file ("<file>.ktx"), in KTX 1.1
+// format: the mip chain of one 2D texture, ready to be uploaded from the
+// mapped pages with glCompressedTexImage2D. A "source" key records size
+// and modification time of the image, plus the parameters the levels
+// were built with; a file whose source or parameters changed is ignored
+// (and rewritten by the caller).
+class KtxFile {
+  MappedFilePtr m_file;
+  uint32_t m_format;          // GL internal format
+  int m_width, m_height;
+  std::vector<size_t> m_offsets;
+  std::vector<uint32_t> m_sizes;
+protected:
+  KtxFile (MappedFilePtr file);
+public:
+  // sidecar of the source if present, valid and up to date, or nullptr
+  static KtxFilePtr Open (const std::string& source, const std::string& params);
+  // levels from the full size down; returns false on failure
+  static bool Write (const std::string& source, const std::string& params,
+                     uint32_t format, int width, int height,
+                     const std::vector<std::vector<unsigned char>>& levels);
+  static std::string GetCacheName (const std::string& source);
+  virtual ~KtxFile ();
+  uint32_t GetFormat () const;
+  int GetWidth () const;
+  int GetHeight () const;
+  int GetLevelCount () const;
+  const unsigned char* GetLevelData (int level) const;
+  uint32_t GetLevelSize (int level) const;
+  size_t GetDataSize () const;   // all levels
+};
+
+#endif
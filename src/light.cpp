@@ -72,9 +72,9 @@ void Light::SetPosition (float x, float y, float z, float w)
 void Light::Load (StatePtr st) const
 {
   ShaderPtr shd = st->GetShader();
-  shd->SetUniform("lamb",m_amb);
-  shd->SetUniform("ldif",m_dif);
-  shd->SetUniform("lspe",m_spe);
+  shd->SetUniform(shd->GetUniformLocation(Shader::LAMB),m_amb);
+  shd->SetUniform(shd->GetUniformLocation(Shader::LDIF),m_dif);
+  shd->SetUniform(shd->GetUniformLocation(Shader::LSPE),m_spe);
 
   // Set position in the lighting space
   glm::mat4 M(1.0f);
@@ -88,7 +88,7 @@ void Light::Load (StatePtr st) const
     M = M * GetReference()->GetModelMatrix();
   }
   glm::vec4 pos = M * m_pos;
-  shd->SetUniform("lpos",pos);
+  shd->SetUniform(shd->GetUniformLocation(Shader::LPOS),pos);
 
   // Spotlight/directional support: compute direction from reference's +Y
   // If there's a reference, use its +Y axis transformed to lighting space.
@@ -98,13 +98,13 @@ void Light::Load (StatePtr st) const
     glm::vec4 d = M * glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
     ldir = glm::normalize(glm::vec3(d));
   }
-  shd->SetUniform("ldir", glm::vec4(ldir, 0.0f)); // vec4 overload, fragment uses xyz
+  shd->SetUniform(shd->GetUniformLocation(Shader::LDIR),glm::vec4(ldir, 0.0f)); // vec4 overload, fragment uses xyz
   // Enable spotlight only when we have a positional light and a reference
   int useSpot = (pos.w != 0.0f && GetReference() != nullptr) ? 1 : 0;
-  shd->SetUniform("useSpot", useSpot);
+  shd->SetUniform(shd->GetUniformLocation(Shader::USESPOT), useSpot);
   // Reasonable defaults (degrees -> cosine cutoff)
-  shd->SetUniform("spotCutoff", cosf(18.0f * 3.14159265f/180.0f));
-  shd->SetUniform("spotExponent", 16.0f);
+  shd->SetUniform(shd->GetUniformLocation(Shader::SPOTCUTOFF), cosf(18.0f * 3.14159265f/180.0f));
+  shd->SetUniform(shd->GetUniformLocation(Shader::SPOTEXPONENT), 16.0f);
   // Distance attenuation (constant, linear, quadratic)
-  shd->SetUniform("att", glm::vec3(1.0f, 0.15f, 0.05f));
+  shd->SetUniform(shd->GetUniformLocation(Shader::ATT), glm::vec3(1.0f, 0.15f, 0.05f));
 }
\ No newline at end of file
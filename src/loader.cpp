@@ -0,0 +1,151 @@
+#include "loader.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#define MAX_THREADS 4
+
+static thread_local bool s_worker = false;
+
+struct LoadJob {
+  Loader::Work work;
+  Loader::Done done;
+  size_t bytes;
+};
+
+// workers take jobs from the queue and move them, done, to the finished list
+struct LoaderPool {
+  std::mutex mutex;
+  std::condition_variable work_cv;     // jobs queued, or quitting
+  std::condition_variable done_cv;     // jobs finished
+  std::deque<LoadJob> queue;
+  std::deque<LoadJob> finished;
+  std::vector<std::thread> threads;
+  unsigned int pending = 0;
+  int nthreads = -1;                   // -1: default
+  bool quit = false;
+  ~LoaderPool ()
+  {
+    Stop();
+  }
+  // workers leave once the queue is empty
+  void Stop ()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      quit = true;
+    }
+    work_cv.notify_all();
+    for (std::thread& t : threads)
+      t.join();
+    threads.clear();
+    quit = false;
+  }
+  void Run ()
+  {
+    s_worker = true;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      work_cv.wait(lock,[this] { return quit || !queue.empty(); });
+      if (queue.empty())
+        return;
+      LoadJob job = std::move(queue.front());
+      queue.pop_front();
+      lock.unlock();
+      job.bytes = job.work();
+      lock.lock();
+      finished.push_back(std::move(job));
+      done_cv.notify_all();
+    }
+  }
+};
+
+static LoaderPool& Pool ()
+{
+  static LoaderPool pool;
+  return pool;
+}
+
+void Loader::SetThreadCount (int n)
+{
+  LoaderPool& pool = Pool();
+  pool.Stop();
+  pool.nthreads = std::max(n,0);
+}
+
+int Loader::GetWorkThreads ()
+{
+  return s_worker ? 1 : 0;
+}
+
+int Loader::GetThreadCount ()
+{
+  LoaderPool& pool = Pool();
+  if (pool.nthreads < 0)
+    pool.nthreads = std::max(1,std::min(MAX_THREADS,int(std::thread::hardware_concurrency())));
+  return pool.nthreads;
+}
+
+void Loader::Submit (Work work, Done done)
+{
+  int nthreads = GetThreadCount();
+  if (nthreads == 0) {
+    work();
+    done();
+    return;
+  }
+  LoaderPool& pool = Pool();
+  // threads are started with the first load
+  if (pool.threads.empty())
+    for (int i=0; i<nthreads; ++i)
+      pool.threads.emplace_back(&LoaderPool::Run,&pool);
+  {
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    pool.queue.push_back({std::move(work),std::move(done),0});
+    pool.pending++;
+  }
+  pool.work_cv.notify_one();
+}
+
+unsigned int Loader::Update (size_t budget)
+{
+  LoaderPool& pool = Pool();
+  unsigned int n = 0;
+  size_t bytes = 0;
+  std::unique_lock<std::mutex> lock(pool.mutex);
+  while (!pool.finished.empty() && (n == 0 || bytes < budget)) {
+    LoadJob job = std::move(pool.finished.front());
+    pool.finished.pop_front();
+    lock.unlock();
+    job.done();
+    bytes += job.bytes;
+    n++;
+    lock.lock();
+    pool.pending--;
+  }
+  return n;
+}
+
+void Loader::Finish ()
+{
+  LoaderPool& pool = Pool();
+  std::unique_lock<std::mutex> lock(pool.mutex);
+  while (pool.pending > 0) {
+    pool.done_cv.wait(lock,[&pool] { return !pool.finished.empty(); });
+    lock.unlock();
+    Update(0);
+    lock.lock();
+  }
+}
+
+unsigned int Loader::GetPendingCount ()
+{
+  LoaderPool& pool = Pool();
+  std::lock_guard<std::mutex> lock(pool.mutex);
+  return pool.pending;
+}
@@ -0,0 +1,37 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <cstddef>
+#include <functional>
+
+#define LOADER_FRAME_BUDGET (32*1024*1024)   // bytes uploaded per frame
+
+// Background loading of resources. The work of a load (reading, decoding,
+// parsing) runs on a pool of worker threads; its completion, which talks
+// to GL, runs on the GL thread from Update, called by Scene::Render before
+// each frame. Completions are paced by the bytes they upload, so a burst
+// of loads spreads over a few frames instead of stalling one.
+class Loader {
+public:
+  // work returns the number of bytes its completion uploads
+  using Work = std::function<size_t()>;
+  using Done = std::function<void()>;
+  // worker threads (default: hardware concurrency, up to 4); with 0,
+  // loads complete synchronously, within Submit
+  static void SetThreadCount (int n);
+  static int GetThreadCount ();
+  static void Submit (Work work, Done done);
+  // threads for parallel steps within a work (parsing, mipmaps): 1 on a
+  // worker, where the pool already occupies the cores; 0 (all cores)
+  // when loads run synchronously
+  static int GetWorkThreads ();
+  // completes finished loads, up to about budget bytes (at least one);
+  // returns the number of loads completed
+  static unsigned int Update (size_t budget=LOADER_FRAME_BUDGET);
+  // waits for and completes every pending load
+  static void Finish ();
+  // submitted and not completed yet
+  static unsigned int GetPendingCount ();
+};
+
+#endif
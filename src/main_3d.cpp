@@ -28,19 +28,49 @@
 #include "cone.h"
 #include "lamp.h"
 #include "table.h"
+#include "bvh.h"
 
+#include <atomic>
 #include <iostream>
 #include <cassert>
 #include <cmath>
+#include <cstdlib>
+#include <new>
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 #include <vector>
 
+// count heap allocations of the GL thread: steady-state frames should
+// not allocate (loader workers allocate while decoding and parsing)
+static std::atomic<unsigned long> g_allocs(0);
+static unsigned long g_frame_allocs = 0;   // allocations of the last frame
+static thread_local bool g_count_allocs = false;   // set on the GL thread
+
+void* operator new (std::size_t size)
+{
+  if (g_count_allocs)
+    g_allocs.fetch_add(1,std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+void operator delete (void* p) noexcept
+{
+  std::free(p);
+}
+void operator delete (void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
 static float viewer_pos[3] = {2.0f, 3.5f, 4.0f};
 
 static ScenePtr scene;
 static Camera3DPtr camera;
 static ArcballPtr arcball;
 static ShaderPtr g_shader;
+static ShaderPtr g_shader_inst;       // instanced variant of g_shader
+static BVHPtr g_picker;               // spatial index for mouse picking
 static bool g_clipEnabled = false;    // desable clip by default
 static bool g_clipKeepAbove = true;  // for table-plane: keep ABOVE the tabletop
 static float g_topY = 1.1f;          // table top height
@@ -103,16 +133,25 @@ static void initialize (void)
   shader->AttachFragmentShader("shaders/ilum_vert/fragment_texture.glsl");
   shader->Link();
   g_shader = shader;
+  // Instanced variant, used when the scene batches repeated shapes
+  ShaderPtr shader_inst = Shader::Make(light,"camera");
+  shader_inst->AttachVertexShader("shaders/ilum_vert/vertex_texture_instanced.glsl");
+  shader_inst->AttachFragmentShader("shaders/ilum_vert/fragment_texture.glsl");
+  shader_inst->Link();
+  shader->SetInstancedShader(shader_inst);
+  g_shader_inst = shader_inst;
 
-  // Set fog defaults (linear fog)
-  shader->UseProgram();
-  shader->SetUniform("fogColor", glm::vec3(1.0f, 1.0f, 1.0f)); // match background
-  shader->SetUniform("fogStart", 3.0f);
-  shader->SetUniform("fogEnd",   8.0f);
-  // Initialize clipping (no planes active by default)
-  shader->SetUniform("clipCount", 0);
-  std::vector<glm::vec4> clipPlanes(4, glm::vec4(0,0,0,0));
-  shader->SetUniform("clipPlane", clipPlanes);
+  for (ShaderPtr shd : {shader, shader_inst}) {
+    // Set fog defaults (linear fog)
+    shd->UseProgram();
+    shd->SetUniform("fogColor", glm::vec3(1.0f, 1.0f, 1.0f)); // match background
+    shd->SetUniform("fogStart", 3.0f);
+    shd->SetUniform("fogEnd",   8.0f);
+    // Initialize clipping (no planes active by default)
+    shd->SetUniform("clipCount", 0);
+    std::vector<glm::vec4> clipPlanes(4, glm::vec4(0,0,0,0));
+    shd->SetUniform("clipPlane", clipPlanes);
+  }
 
   // Textures
   AppearancePtr tex_white = Texture::Make("decal", glm::vec3(1.0f,1.0f,1.0f));
@@ -170,6 +209,7 @@ static void initialize (void)
   // Assemble root with shader and a default roughness (fallback)
   NodePtr root = Node::Make(shader, { rough_default }, { table_wrapped, lamp_wrapped, ball, cyl_obj, page });
   scene = Scene::Make(root);
+  g_picker = BVH::Make(root);
 }
 
 static void display (GLFWwindow* win)
@@ -189,11 +229,13 @@ static void display (GLFWwindow* win)
     glm::mat4 invTransV = glm::transpose(glm::inverse(V));
     glm::vec4 plane_eye = invTransV * plane_world;
     // Set uniforms
-    g_shader->UseProgram();
-    g_shader->SetUniform("clipCount", g_clipEnabled ? 1 : 0);
-    std::vector<glm::vec4> planes(4, glm::vec4(0.0f));
+    static std::vector<glm::vec4> planes(4, glm::vec4(0.0f));
     planes[0] = plane_eye;
-    g_shader->SetUniform("clipPlane", planes);
+    for (ShaderPtr shd : {g_shader, g_shader_inst}) {
+      shd->UseProgram();
+      shd->SetUniform("clipCount", g_clipEnabled ? 1 : 0);
+      shd->SetUniform("clipPlane", planes);
+    }
   }
   Error::Check("before render");
   scene->Render(camera);
@@ -219,6 +261,46 @@ static void keyboard (GLFWwindow* window, int key, int scancode, int action, int
     g_clipKeepAbove = !g_clipKeepAbove;
     printf("Clip keep %s table\n", g_clipKeepAbove ? "ABOVE" : "BELOW");
   }
+  if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+    scene->SetCompiled(!scene->IsCompiled());
+    printf("Render %s\n", scene->IsCompiled() ? "COMPILED (flat list)" : "RECURSIVE");
+  }
+  if (key == GLFW_KEY_O && action == GLFW_PRESS) {
+    scene->SetSorted(!scene->IsSorted());
+    printf("Sorted submission %s\n", scene->IsSorted() ? "ON" : "OFF");
+  }
+  if (key == GLFW_KEY_I && action == GLFW_PRESS) {
+    scene->SetInstanced(!scene->IsInstanced());
+    printf("Instancing %s\n", scene->IsInstanced() ? "ON" : "OFF");
+  }
+  if (key == GLFW_KEY_F && action == GLFW_PRESS) {
+    scene->SetCulling(!scene->IsCulling());
+    printf("Frustum culling %s\n", scene->IsCulling() ? "ON" : "OFF");
+  }
+  if (key == GLFW_KEY_S && action == GLFW_PRESS && scene->GetState()) {
+    StatePtr st = scene->GetState();
+    printf("GL state calls: %u issued, %u elided\n", st->GetIssuedCalls(), st->GetElidedCalls());
+    if (st->IsCulling())
+      printf("Shapes: %u visible, %u culled\n", st->GetVisibleCount(), st->GetCulledCount());
+    printf("Heap allocations in last frame: %lu (arena: %zu of %zu bytes, %u blocks)\n",
+           g_frame_allocs, st->GetArena()->GetUsed(), st->GetArena()->GetCapacity(),
+           st->GetArena()->GetHeapAllocs());
+    printf("Geometry: %u entries, %u vertices, %u indices, %zu bytes\n",
+           Geometry::GetEntryCount(), Geometry::GetVertexCount(), Geometry::GetIndexCount(),
+           Geometry::GetMemoryUsage());
+    Texture::CacheStats ts = Texture::GetCacheStats();
+    printf("Textures: %u entries, %zu bytes, %u hits, %u misses\n",
+           ts.entries, ts.bytes, ts.hits, ts.misses);
+    Mesh::LoadStats ms = Mesh::GetLoadStats();
+    printf("Meshes: %u loaded, %u triangles\n", ms.meshes, ms.triangles);
+    if (ms.optimized)
+      printf("  optimized %u: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", ms.optimized,
+             ms.acmr_before, ms.acmr_after, ms.atvr_before, ms.atvr_after);
+    if (ms.lods)
+      printf("  %u coarser levels, %u triangles\n", ms.lods, ms.lod_triangles);
+    if (ms.meshlets)
+      printf("  %u meshlets\n", ms.meshlets);
+  }
 }
 
 static void resize (GLFWwindow* win, int width, int height)
@@ -247,8 +329,39 @@ static void cursorinit (GLFWwindow* win, double x, double y)
   arcball->InitMouseMotion(int(x),int(y));
   glfwSetCursorPosCallback(win, cursorpos);     // cursor position callback
 }
+static void pick (GLFWwindow* win)
+{
+  double x, y;
+  int wn_w, wn_h, fb_w, fb_h;
+  glfwGetCursorPos(win, &x, &y);
+  glfwGetWindowSize(win, &wn_w, &wn_h);
+  glfwGetFramebufferSize(win, &fb_w, &fb_h);
+  x = x * fb_w / wn_w;
+  y = (wn_h - y) * fb_h / wn_h;
+  // unproject cursor at near and far planes to get a world-space ray
+  glm::vec4 viewport(0.0f, 0.0f, float(fb_w), float(fb_h));
+  glm::mat4 view = camera->GetViewMatrix();
+  glm::mat4 proj = camera->GetProjMatrix();
+  glm::vec3 p0 = glm::unProject(glm::vec3(x, y, 0.0f), view, proj, viewport);
+  glm::vec3 p1 = glm::unProject(glm::vec3(x, y, 1.0f), view, proj, viewport);
+  g_picker->Refit();
+  float t;
+  int item = g_picker->Pick(p0, glm::normalize(p1 - p0), &t);
+  if (item < 0) {
+    printf("Pick: nothing\n");
+    return;
+  }
+  glm::vec3 c = BVH::GetNodeBounds(g_picker->GetItemNode(item)).GetCenter();
+  printf("Pick: item %d at distance %.3f (center %.2f %.2f %.2f)\n", item, t, c.x, c.y, c.z);
+}
+
 static void mousebutton (GLFWwindow* win, int button, int action, int mods)
 {
+  if (button == GLFW_MOUSE_BUTTON_RIGHT) {
+    if (action == GLFW_PRESS)
+      pick(win);
+    return;
+  }
   if (action == GLFW_PRESS) {
     glfwSetCursorPosCallback(win, cursorinit);     // cursor position callback
   }
@@ -258,6 +371,7 @@ static void mousebutton (GLFWwindow* win, int button, int action, int mods)
 
 int main ()
 {
+  g_count_allocs = true;   // this is the GL thread
   glfwInit();
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR,4);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR,1);
@@ -296,7 +410,9 @@ int main ()
   initialize();
 
   while(!glfwWindowShouldClose(win)) {
+    unsigned long allocs = g_allocs.load(std::memory_order_relaxed);
     display(win);
+    g_frame_allocs = g_allocs.load(std::memory_order_relaxed) - allocs;
     glfwSwapBuffers(win);
     glfwPollEvents();
   }
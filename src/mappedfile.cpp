@@ -0,0 +1,115 @@
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <iostream>
+#include <cstdlib>
+
+MappedFilePtr MappedFile::Make (const std::string& filename)
+{
+  return MappedFilePtr(new MappedFile(filename));
+}
+
+std::string MappedFile::GetTempName (const std::string& filename)
+{
+  // concurrent loads of one file write their caches at the same time
+  static std::atomic<unsigned int> s_count(0);
+#ifdef _WIN32
+  unsigned long pid = GetCurrentProcessId();
+#else
+  unsigned long pid = (unsigned long)getpid();
+#endif
+  return filename + "." + std::to_string(pid) + "." + std::to_string(s_count++) + ".tmp";
+}
+
+#ifdef _WIN32
+
+MappedFile::MappedFile (const std::string& filename)
+: m_data(nullptr),
+  m_size(0),
+  m_file(INVALID_HANDLE_VALUE),
+  m_mapping(nullptr)
+{
+  m_file = CreateFileA(filename.c_str(),GENERIC_READ,FILE_SHARE_READ,nullptr,
+                       OPEN_EXISTING,FILE_FLAG_SEQUENTIAL_SCAN,nullptr);
+  if (m_file == INVALID_HANDLE_VALUE) {
+    std::cerr << "Could not open file: " << filename << std::endl;
+    exit(1);
+  }
+  LARGE_INTEGER size;
+  GetFileSizeEx(m_file,&size);
+  m_size = size_t(size.QuadPart);
+  if (m_size == 0)
+    return;
+  m_mapping = CreateFileMappingA(m_file,nullptr,PAGE_READONLY,0,0,nullptr);
+  if (m_mapping)
+    m_data = static_cast<const char*>(MapViewOfFile(m_mapping,FILE_MAP_READ,0,0,0));
+  if (!m_data) {
+    std::cerr << "Could not map file: " << filename << std::endl;
+    exit(1);
+  }
+}
+
+MappedFile::~MappedFile ()
+{
+  if (m_data)
+    UnmapViewOfFile(m_data);
+  if (m_mapping)
+    CloseHandle(m_mapping);
+  if (m_file != INVALID_HANDLE_VALUE)
+    CloseHandle(m_file);
+}
+
+#else
+
+MappedFile::MappedFile (const std::string& filename)
+: m_data(nullptr),
+  m_size(0)
+{
+  int fd = open(filename.c_str(),O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Could not open file: " << filename << std::endl;
+    exit(1);
+  }
+  struct stat st;
+  fstat(fd,&st);
+  m_size = size_t(st.st_size);
+  if (m_size > 0) {
+    void* p = mmap(nullptr,m_size,PROT_READ,MAP_PRIVATE,fd,0);
+    if (p == MAP_FAILED) {
+      std::cerr << "Could not map file: " << filename << std::endl;
+      exit(1);
+    }
+    madvise(p,m_size,MADV_SEQUENTIAL);
+    m_data = static_cast<const char*>(p);
+  }
+  close(fd);   // the mapping stays valid
+}
+
+MappedFile::~MappedFile ()
+{
+  if (m_data)
+    munmap((void*)m_data,m_size);
+}
+
+#endif
+
+const char* MappedFile::GetData () const
+{
+  return m_data;
+}
+
+size_t MappedFile::GetSize () const
+{
+  return m_size;
+}
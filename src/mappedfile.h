@@ -0,0 +1,31 @@
+#include <memory>
+class MappedFile;
+using MappedFilePtr = std::shared_ptr<MappedFile>; 
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+  const char* m_data;
+  size_t m_size;
+#ifdef _WIN32
+  void* m_file;
+  void* m_mapping;
+#endif
+protected:
+  MappedFile (const std::string& filename);
+public:
+  static MappedFilePtr Make (const std::string& filename);
+  // temporary name next to filename, unique to the caller (process and
+  // call), for files written then renamed over filename
+  static std::string GetTempName (const std::string& filename);
+  virtual ~MappedFile ();
+  const char* GetData () const;
+  size_t GetSize () const;
+};
+
+#endif
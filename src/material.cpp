@@ -1,6 +1,7 @@
 #include "material.h"
 #include "shader.h"
 #include "state.h"
+#include "node.h"
 
 #ifdef _WIN32
 //#define GLAD_GL_IMPLEMENTATION // Necessary for headeronly version.
@@ -50,14 +51,21 @@ void Material::SetShininess (float shi)
 }
 void Material::SetOpacity (float opacity)
 {
+  // compiled lists draw translucent materials in their own pass
+  if ((opacity < 1.0f) != (m_opacity < 1.0f))
+    Node::InvalidateStructure();
   m_opacity = opacity;
 }
+float Material::GetOpacity () const
+{
+  return m_opacity;
+}
 void Material::Load (StatePtr st)
 {
   ShaderPtr shd = st->GetShader();
-  shd->SetUniform("mamb",m_amb);
-  shd->SetUniform("mdif",m_dif);
-  shd->SetUniform("mspe",m_spe);
-  shd->SetUniform("mshi",m_shi);
-  shd->SetUniform("mopacity",m_opacity);
+  shd->SetUniform(shd->GetUniformLocation(Shader::MAMB),m_amb);
+  shd->SetUniform(shd->GetUniformLocation(Shader::MDIF),m_dif);
+  shd->SetUniform(shd->GetUniformLocation(Shader::MSPE),m_spe);
+  shd->SetUniform(shd->GetUniformLocation(Shader::MSHI),m_shi);
+  shd->SetUniform(shd->GetUniformLocation(Shader::MOPACITY),m_opacity);
 }
@@ -24,6 +24,7 @@ public:
   void SetSpecular (float r, float g, float b);
   void SetShininess (float shi);
   void SetOpacity (float opacity);
+  float GetOpacity () const;
   virtual void Load (StatePtr st);
 };
 
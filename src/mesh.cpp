@@ -1,4 +1,9 @@
 #include "mesh.h"
+#include "mshparser.h"
+#include "meshcache.h"
+#include "meshoptimizer.h"
+#include "loader.h"
+#include "node.h"
 
 #ifdef _WIN32
 //#define GLAD_GL_IMPLEMENTATION // Necessary for headeronly version.
@@ -9,14 +14,139 @@
 #include <GL/glew.h>
 #endif
 
+#include <cfloat>
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <cstdlib>
 
+static bool s_binary_cache = true;
+static bool s_optimize = false;
+static std::vector<float> s_lod_ratios;
+static float s_lod_threshold = 0.001f;
+static bool s_meshlets = false;
+
+// completed loads (GL thread)
+static Mesh::LoadStats s_stats = {0, 0, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0, 0, 0};
+
+// fewer clusters are drawn whole
+#define MIN_MESHLETS 16
+
+void Mesh::SetBinaryCache (bool enabled)
+{
+  s_binary_cache = enabled;
+}
+
+void Mesh::SetOptimize (bool enabled)
+{
+  s_optimize = enabled;
+}
+
+void Mesh::SetLODs (const std::vector<float>& ratios)
+{
+  s_lod_ratios = ratios;
+  if (s_lod_ratios.size() > MESH_CACHE_MAX_LODS)
+    s_lod_ratios.resize(MESH_CACHE_MAX_LODS);
+}
+
+void Mesh::SetLODThreshold (float fraction)
+{
+  s_lod_threshold = fraction;
+}
+
+void Mesh::SetMeshlets (bool enabled)
+{
+  s_meshlets = enabled;
+}
+
+// Load of a mesh file: prepared on a worker thread (see Loader) with the
+// settings at the time of the request, then uploaded on the GL thread
+struct MeshLoad {
+  std::string filename;
+  unsigned int flags;                   // MeshCache flags
+  bool binary_cache;
+  bool host;                            // parse to a host copy
+  bool build_meshlets;
+  std::vector<float> lod_ratios;
+  MeshCachePtr cache;                   // up to date sidecar, or
+  MshParserPtr parser;                  // counted, to be parsed into the arena, or
+  std::vector<Geometry::Vertex> verts;  // processed host copy
+  std::vector<unsigned int> indices;
+  std::vector<MeshSimplifier::LOD> lods;
+  std::vector<Meshlet> meshlets;
+  Bounds bounds;
+  bool optimized = false;               // reordered here, with
+  MeshOptimizer::Stats opt;
+};
+
+// returns the bytes to upload
+static size_t Prepare (MeshLoad& ld)
+{
+  // up to date binary sidecar: upload its pages, no parsing
+  if (ld.binary_cache)
+    ld.cache = MeshCache::Open(ld.filename,ld.flags,ld.lod_ratios);
+  if (ld.cache)
+    return size_t(ld.cache->GetVertexCount())*sizeof(Geometry::Vertex) +
+           size_t(ld.cache->GetIndexCount())*sizeof(unsigned int);
+  // count records first, then parse
+  MshParserPtr parser = MshParser::Make(ld.filename,Loader::GetWorkThreads());
+  unsigned int nverts = parser->GetVertexCount();
+  unsigned int nind = 3*parser->GetTriangleCount();
+  if (nverts == 0 || nind == 0) {
+    std::cerr << "Empty mesh: " << ld.filename << std::endl;
+    return 0;
+  }
+  size_t bytes = size_t(nverts)*sizeof(Geometry::Vertex) + size_t(nind)*sizeof(unsigned int);
+  if (!ld.host) {
+    ld.parser = parser;
+    return bytes;
+  }
+  // host copy, to be optimized, simplified, clustered, written to the
+  // sidecar and/or compressed
+  ld.verts.resize(nverts);
+  ld.indices.resize(nind);
+  ld.bounds = parser->Parse(ld.verts.data(),ld.indices.data());
+  if (ld.flags & MeshCache::OPTIMIZED) {
+    ld.opt = MeshOptimizer::Optimize(ld.verts,ld.indices);
+    ld.optimized = true;
+  }
+  if (!ld.lod_ratios.empty()) {
+    ld.lods = MeshSimplifier::BuildLODs(ld.verts,ld.indices,ld.lod_ratios);
+    if (ld.flags & MeshCache::OPTIMIZED)
+      for (MeshSimplifier::LOD& lod : ld.lods)
+        MeshOptimizer::OptimizeVertexCache(lod.indices,nverts);
+  }
+  if (ld.build_meshlets) {
+    ld.meshlets = Meshlets::Build(ld.verts,ld.indices);
+    if (ld.meshlets.size() < MIN_MESHLETS)
+      ld.meshlets.clear();
+  }
+  if (ld.binary_cache)
+    MeshCache::Write(ld.filename,ld.flags,ld.verts.data(),(unsigned int)ld.verts.size(),
+                     ld.indices.data(),(unsigned int)ld.indices.size(),ld.bounds,
+                     ld.lod_ratios,ld.lods,ld.meshlets);
+  return bytes;
+}
+
 MeshPtr Mesh::Make (const std::string& filename)
 {
-  return MeshPtr(new Mesh(filename));
+  MeshPtr mesh(new Mesh(filename));
+  std::shared_ptr<MeshLoad> ld = std::make_shared<MeshLoad>();
+  ld->filename = filename;
+  ld->flags = (s_optimize ? MeshCache::OPTIMIZED : 0) | (s_meshlets ? MeshCache::MESHLETS : 0);
+  ld->binary_cache = s_binary_cache;
+  ld->build_meshlets = s_meshlets;
+  ld->lod_ratios = s_lod_ratios;
+  // parsing straight into the mapped arena has to happen on the GL thread
+  ld->host = s_binary_cache || s_optimize || s_meshlets || Geometry::IsCompact() ||
+             !s_lod_ratios.empty() || Loader::GetThreadCount() > 0;
+  // the mesh draws nothing until loaded; a mesh dropped meanwhile is not uploaded
+  std::weak_ptr<Mesh> handle = mesh;
+  Loader::Submit([ld] () { return Prepare(*ld); },
+                 [ld,handle] () {
+                   if (MeshPtr m = handle.lock())
+                     m->Finish(*ld);
+                 });
+  return mesh;
 }
 
 MeshPtr Mesh::Make ()
@@ -24,56 +154,78 @@ MeshPtr Mesh::Make ()
   return MeshPtr(new Mesh());
 }
 
-Mesh::Mesh (const std::string& filename)
-: m_nind(0)
+Mesh::LoadStats Mesh::GetLoadStats ()
 {
-  std::vector<float> coords;
-  std::vector<float> normals;
-  std::vector<unsigned int> indices;
-  // read file
-  std::fstream fp;
-  fp.open(filename,std::ios::in);
-  if (!fp) {
-    std::cerr << "Could not open file: " << filename << std::endl;
-    exit(1);
+  LoadStats st = s_stats;
+  if (st.optimized) {
+    st.acmr_before /= st.optimized;
+    st.acmr_after /= st.optimized;
+    st.atvr_before /= st.optimized;
+    st.atvr_after /= st.optimized;
   }
-  while (!fp.eof()) {
-    char c;
-    float x, y, z;
-    unsigned int i, j, k;
-    fp >> c;
-    switch (c) {
-      case 'V':
-        fp >> x >> y >> z;
-        coords.push_back(x);
-        coords.push_back(y);
-        coords.push_back(z);
-      break;
-      case 'N':
-        fp >> x >> y >> z;
-        normals.push_back(x);
-        normals.push_back(y);
-        normals.push_back(z);
-      break;
-      case 'T':
-        fp >> i >> j >> k;
-        indices.push_back(i);
-        indices.push_back(j);
-        indices.push_back(k);
-      break;
+  return st;
+}
+
+Mesh::Mesh (const std::string& )
+: m_vao(0),
+  m_nind(0)
+{
+}
+
+void Mesh::Finish (MeshLoad& ld)
+{
+  if (ld.cache) {
+    MeshCachePtr cache = ld.cache;
+    m_nind = cache->GetIndexCount();
+    m_geom = Geometry::Make("",cache->GetVertices(),cache->GetVertexCount(),
+                            cache->GetIndices(),m_nind);
+    for (unsigned int i=0; i<cache->GetLODCount() && cache->GetLODIndexCount(i); ++i) {
+      m_lods.push_back(Geometry::Make(m_geom,cache->GetLODIndices(i),cache->GetLODIndexCount(i)));
+      m_lod_errors.push_back(cache->GetLODError(i));
     }
+    m_meshlets.assign(cache->GetMeshlets(),cache->GetMeshlets()+cache->GetMeshletCount());
+    m_bounds = cache->GetBounds();
   }
-  fp.close();
-  m_nind = (unsigned int)(indices.size());
-
-  // create VAO
-  glGenVertexArrays(1,&m_vao);
-  SetCoordBuffer(int(coords.size()),coords.data(),3,0);
-  SetNormalBuffer(int(normals.size()),normals.data(),3,0);
-  SetIndexBuffer(int(indices.size()),indices.data());
+  else if (ld.parser) {
+    // straight into the geometry arena
+    Geometry::Vertex* verts;
+    unsigned int* indices;
+    m_nind = 3*ld.parser->GetTriangleCount();
+    m_geom = Geometry::MakeMapped("",ld.parser->GetVertexCount(),m_nind,&verts,&indices);
+    m_bounds = ld.parser->Parse(verts,indices);
+    Geometry::Unmap();
+  }
+  else {
+    m_nind = (unsigned int)ld.indices.size();
+    m_geom = Geometry::Make("",ld.verts,ld.indices);
+    for (const MeshSimplifier::LOD& lod : ld.lods) {
+      m_lods.push_back(Geometry::Make(m_geom,lod.indices.data(),(unsigned int)lod.indices.size()));
+      m_lod_errors.push_back(lod.error);
+    }
+    m_meshlets.swap(ld.meshlets);
+    m_bounds = ld.bounds;
+  }
+  s_stats.meshes++;
+  s_stats.triangles += m_nind/3;
+  s_stats.lods += (unsigned int)m_lods.size();
+  for (const GeometryPtr& lod : m_lods)
+    s_stats.lod_triangles += lod->GetCount()/3;
+  s_stats.meshlets += (unsigned int)m_meshlets.size();
+  if (ld.optimized) {
+    // sums, averaged by GetLoadStats
+    s_stats.optimized++;
+    s_stats.acmr_before += ld.opt.acmr_before;
+    s_stats.acmr_after += ld.opt.acmr_after;
+    s_stats.atvr_before += ld.opt.atvr_before;
+    s_stats.atvr_after += ld.opt.atvr_after;
+  }
+  // node bounds and compiled lists saw this mesh empty
+  Node::InvalidateShapes();
 }
 
 Mesh::Mesh () 
+: m_vao(0),
+  m_nind(0)
 {
   glGenVertexArrays(1,&m_vao);
 }
@@ -84,6 +236,11 @@ Mesh::~Mesh ()
 
 void Mesh::SetCoordBuffer (int size, const float* data, int ncomp, int stride)
 {
+  // update bounds (stride given in bytes, as in GL)
+  int step = stride ? stride/int(sizeof(float)) : ncomp;
+  m_bounds = Bounds();
+  for (int i=0; i+ncomp<=size; i+=step)
+    m_bounds.Merge(glm::vec3(data[i],data[i+1],ncomp>2?data[i+2]:0.0f));
   glBindVertexArray(m_vao);
   // create coord buffer
   GLuint id;
@@ -140,8 +297,104 @@ void Mesh::SetIndexBuffer (int size, const unsigned int* data)
   m_nind = size;
 }
 
-void Mesh::Draw (StatePtr )
+void Mesh::Draw (StatePtr st)
 {
-  glBindVertexArray(m_vao);
+  if (m_geom) {
+    DrawLOD(st,SelectLOD(st));
+    return;
+  }
+  if (!m_vao)    // still loading
+    return;
+  st->BindVertexArray(m_vao);
+  st->LoadVertexDecode(false);
   glDrawElements(GL_TRIANGLES,m_nind,GL_UNSIGNED_INT,0);
-}
\ No newline at end of file
+}
+
+// meshlets are culled per instance
+bool Mesh::CanDrawInstanced () const
+{
+  return m_meshlets.empty();
+}
+
+void Mesh::DrawInstanced (StatePtr st, int ninstances)
+{
+  if (m_geom) {
+    m_geom->DrawInstanced(st,ninstances);
+    return;
+  }
+  if (!m_vao)
+    return;
+  st->BindVertexArray(m_vao);
+  st->LoadVertexDecode(false);
+  glDrawElementsInstanced(GL_TRIANGLES,m_nind,GL_UNSIGNED_INT,0,ninstances);
+}
+
+int Mesh::GetLODCount () const
+{
+  return 1 + (int)m_lods.size();
+}
+
+// A level is fine while its error projects below the threshold
+float Mesh::GetLODLimit (int level) const
+{
+  if (level == 0 || m_lod_errors[level-1] <= 0.0f)
+    return FLT_MAX;
+  return s_lod_threshold/m_lod_errors[level-1];
+}
+
+void Mesh::DrawLOD (StatePtr st, int level)
+{
+  if (!m_geom)
+    return;
+  if (level == 0 && !m_meshlets.empty())
+    DrawMeshlets(st);
+  else if (level == 0)
+    m_geom->Draw(st);
+  else
+    m_lods[level-1]->Draw(st);
+}
+
+void Mesh::DrawInstancedLOD (StatePtr st, int ninstances, int level)
+{
+  if (!m_geom)
+    return;
+  if (level == 0)
+    m_geom->DrawInstanced(st,ninstances);
+  else
+    m_lods[level-1]->DrawInstanced(st,ninstances);
+}
+
+// Visible meshlets, as merged index ranges, in one multi-draw call
+void Mesh::DrawMeshlets (StatePtr st)
+{
+  if (!st->IsCulling()) {
+    m_geom->Draw(st);
+    return;
+  }
+  // frustum and eye in object space (no cone test in orthographic views)
+  glm::mat4 proj = st->GetCamera()->GetProjMatrix();
+  glm::mat4 mv = st->GetCamera()->GetViewMatrix() * st->GetCurrentMatrix();
+  Frustum frustum(proj*mv);
+  glm::vec3 eye = glm::vec3(glm::inverse(mv)*glm::vec4(0.0f,0.0f,0.0f,1.0f));
+  const glm::vec3* backface = proj[2][3] != 0.0f ? &eye : nullptr;
+  unsigned int* first = st->GetArena()->Alloc<unsigned int>(m_meshlets.size());
+  unsigned int* count = st->GetArena()->Alloc<unsigned int>(m_meshlets.size());
+  int n = 0;
+  for (const Meshlet& m : m_meshlets) {
+    if (Meshlets::IsCulled(m,frustum,backface))
+      continue;
+    if (n > 0 && first[n-1]+count[n-1] == m.first)
+      count[n-1] += m.count;
+    else {
+      first[n] = m.first;
+      count[n] = m.count;
+      n++;
+    }
+  }
+  m_geom->DrawRanges(st,first,count,n);
+}
+
+Bounds Mesh::GetBounds () const
+{
+  return m_bounds;
+}
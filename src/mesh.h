@@ -1,22 +1,60 @@
 #include <memory>
 class Mesh;
+struct MeshLoad;
 using MeshPtr = std::shared_ptr<Mesh>; 
 
 #ifndef MESH_H
 #define MESH_H
 
 #include "shape.h"
+#include "geometry.h"
+#include "meshlets.h"
 #include <string>
+#include <vector>
 
 class Mesh : public Shape {
-  unsigned int m_vao;
+  GeometryPtr m_geom;   // loaded meshes live in the geometry arena
+  std::vector<GeometryPtr> m_lods;  // coarser levels, over the same vertices
+  std::vector<float> m_lod_errors;  // simplification error of each level
+  std::vector<Meshlet> m_meshlets;  // clusters of the finest level (large meshes)
+  unsigned int m_vao;   // buffers set through the Set*Buffer interface
   unsigned int m_nind;  // number of indices
+  Bounds m_bounds;      // computed from the coordinate buffer
+  void DrawMeshlets (StatePtr st);
+  void Finish (MeshLoad& ld);
 protected:
   Mesh (const std::string& filename);
   Mesh ();
 public:
+  // returns right away: the file is loaded in the background (see
+  // Loader) and the mesh draws nothing until it is resident
   static MeshPtr Make (const std::string& filename);
   static MeshPtr Make ();
+  // totals over the meshes loaded so far
+  struct LoadStats {
+    unsigned int meshes;
+    unsigned int triangles;          // finest levels
+    unsigned int optimized;          // reordered at load (not read from the sidecar)
+    float acmr_before, acmr_after;   // averages over the optimized meshes
+    float atvr_before, atvr_after;
+    unsigned int lods;               // coarser levels
+    unsigned int lod_triangles;      // in the coarser levels
+    unsigned int meshlets;
+  };
+  static LoadStats GetLoadStats ();
+  // keep a binary sidecar of loaded files (default: enabled)
+  static void SetBinaryCache (bool enabled);
+  // reorder loaded meshes for vertex cache, overdraw and fetch (default: disabled)
+  static void SetOptimize (bool enabled);
+  // levels of detail of loaded meshes, as decreasing triangle ratios
+  // (default: none; up to MESH_CACHE_MAX_LODS); a level is drawn when its
+  // error projects below the threshold, as a fraction of the viewport
+  // height (default: 0.001)
+  static void SetLODs (const std::vector<float>& ratios);
+  static void SetLODThreshold (float fraction);
+  // split large loaded meshes into meshlets, culled against the frustum
+  // and back facing before drawing (default: disabled)
+  static void SetMeshlets (bool enabled);
   virtual ~Mesh ();
   void SetCoordBuffer (int size, const float* data, int ncomp, int stride);
   void SetNormalBuffer (int size, const float* data, int ncomp, int stride);
@@ -24,5 +62,12 @@ public:
   void SetTexCoordBuffer (int size, const float* data, int ncomp, int stride);
   void SetIndexBuffer (int size, const unsigned int* data);
   virtual void Draw (StatePtr st);
+  virtual Bounds GetBounds () const;
+  virtual bool CanDrawInstanced () const;
+  virtual void DrawInstanced (StatePtr st, int ninstances);
+  virtual int GetLODCount () const;
+  virtual float GetLODLimit (int level) const;
+  virtual void DrawLOD (StatePtr st, int level);
+  virtual void DrawInstancedLOD (StatePtr st, int ninstances, int level);
 };
 #endif
\ No newline at end of file
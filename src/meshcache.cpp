@@ -0,0 +1,252 @@
+#include "meshcache.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+
+#define CACHE_VERSION 3
+#define DATA_OFFSET 128   // vertices start here (header padded)
+
+// FNV-1a, 64 bits
+static uint64_t Hash (const char* data, size_t size)
+{
+  uint64_t h = 14695981039346656037ull;
+  for (size_t i=0; i<size; ++i) {
+    h ^= (unsigned char)data[i];
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+static bool SourceInfo (const std::string& source, uint64_t* size, int64_t* time)
+{
+  std::error_code ec;
+  *size = std::filesystem::file_size(source,ec);
+  if (ec)
+    return false;
+  *time = std::filesystem::last_write_time(source,ec).time_since_epoch().count();
+  return !ec;
+}
+
+static uint64_t SourceHash (const std::string& source)
+{
+  MappedFilePtr file = MappedFile::Make(source);
+  return Hash(file->GetData(),file->GetSize());
+}
+
+// the LOD table follows the indices
+static const char* LODTable (const char* data, uint32_t nverts, uint32_t nindices)
+{
+  return data + DATA_OFFSET + size_t(nverts)*sizeof(Geometry::Vertex) +
+         size_t(nindices)*sizeof(unsigned int);
+}
+
+std::string MeshCache::GetCacheName (const std::string& source)
+{
+  return source + ".bin";
+}
+
+static bool SameRatios (uint32_t nlods, const float* ratios, const std::vector<float>& expected)
+{
+  if (nlods != expected.size())
+    return false;
+  for (uint32_t i=0; i<nlods; ++i)
+    if (ratios[i] != expected[i])
+      return false;
+  return true;
+}
+
+MeshCachePtr MeshCache::Open (const std::string& source, unsigned int flags,
+                              const std::vector<float>& lod_ratios)
+{
+  std::string name = GetCacheName(source);
+  std::error_code ec;
+  if (!std::filesystem::exists(name,ec))
+    return nullptr;
+  uint64_t size;
+  int64_t time;
+  if (!SourceInfo(source,&size,&time))
+    return nullptr;
+  MappedFilePtr file = MappedFile::Make(name);
+  if (file->GetSize() < DATA_OFFSET)
+    return nullptr;
+  const Header* h = reinterpret_cast<const Header*>(file->GetData());
+  if (memcmp(h->magic,"MSHB",4) != 0 || h->version != CACHE_VERSION ||
+      h->vertex_size != sizeof(Geometry::Vertex) || h->flags != flags ||
+      h->nlods > MESH_CACHE_MAX_LODS || !SameRatios(h->nlods,h->lod_ratios,lod_ratios))
+    return nullptr;
+  uint64_t expected = DATA_OFFSET + uint64_t(h->nverts)*sizeof(Geometry::Vertex) +
+                      uint64_t(h->nindices)*sizeof(unsigned int) + h->nlods*sizeof(LODEntry);
+  if (file->GetSize() < expected)
+    return nullptr;
+  const LODEntry* lods = reinterpret_cast<const LODEntry*>(
+    LODTable(file->GetData(),h->nverts,h->nindices));
+  for (uint32_t i=0; i<h->nlods; ++i)
+    expected += uint64_t(lods[i].nindices)*sizeof(unsigned int);
+  expected += uint64_t(h->nmeshlets)*sizeof(Meshlet);
+  if (file->GetSize() != expected)
+    return nullptr;
+  // stale source: same size and time, or (touched only) same content
+  if (h->source_size != size)
+    return nullptr;
+  if (h->source_time != time) {
+    if (h->source_hash != SourceHash(source))
+      return nullptr;
+    // same content: record the new time, so that later opens skip the hash
+    // (on failure the cache is still used, only hashed again next time)
+    if (FILE* fp = fopen(name.c_str(),"r+b")) {
+      if (fseek(fp,long(offsetof(Header,source_time)),SEEK_SET) == 0)
+        fwrite(&time,sizeof(time),1,fp);
+      fclose(fp);
+    }
+  }
+  return MeshCachePtr(new MeshCache(file));
+}
+
+bool MeshCache::Write (const std::string& source, unsigned int flags,
+                       const Geometry::Vertex* verts, unsigned int nverts,
+                       const unsigned int* indices, unsigned int nindices,
+                       const Bounds& bounds,
+                       const std::vector<float>& lod_ratios,
+                       const std::vector<MeshSimplifier::LOD>& lods,
+                       const std::vector<Meshlet>& meshlets)
+{
+  static_assert(sizeof(Header) <= DATA_OFFSET,"header does not fit");
+  if (lod_ratios.size() > MESH_CACHE_MAX_LODS)
+    return false;
+  Header h;
+  memset(&h,0,sizeof(h));
+  memcpy(h.magic,"MSHB",4);
+  h.version = CACHE_VERSION;
+  h.vertex_size = sizeof(Geometry::Vertex);
+  h.nverts = nverts;
+  h.nindices = nindices;
+  h.flags = flags;
+  if (!SourceInfo(source,&h.source_size,&h.source_time))
+    return false;
+  h.source_hash = SourceHash(source);
+  for (int k=0; k<3; ++k) {
+    h.bmin[k] = bounds.GetMin()[k];
+    h.bmax[k] = bounds.GetMax()[k];
+  }
+  // ratios as requested; levels that were dropped are not stored
+  h.nlods = (uint32_t)lod_ratios.size();
+  for (size_t i=0; i<lod_ratios.size(); ++i)
+    h.lod_ratios[i] = lod_ratios[i];
+  h.nmeshlets = (uint32_t)meshlets.size();
+  std::vector<LODEntry> table(lod_ratios.size());
+  for (size_t i=0; i<table.size(); ++i) {
+    table[i].nindices = i < lods.size() ? (uint32_t)lods[i].indices.size() : 0;
+    table[i].error = i < lods.size() ? lods[i].error : 0.0f;
+  }
+  // write to a temporary file, renamed when complete
+  std::string name = GetCacheName(source);
+  std::string tmp = MappedFile::GetTempName(name);
+  FILE* fp = fopen(tmp.c_str(),"wb");
+  if (!fp)
+    return false;
+  char pad[DATA_OFFSET] = {0};
+  bool ok = fwrite(&h,sizeof(h),1,fp) == 1 &&
+            fwrite(pad,DATA_OFFSET-sizeof(h),1,fp) == 1 &&
+            fwrite(verts,sizeof(Geometry::Vertex),nverts,fp) == nverts &&
+            fwrite(indices,sizeof(unsigned int),nindices,fp) == nindices &&
+            fwrite(table.data(),sizeof(LODEntry),table.size(),fp) == table.size();
+  for (size_t i=0; ok && i<lods.size() && i<table.size(); ++i)
+    ok = fwrite(lods[i].indices.data(),sizeof(unsigned int),lods[i].indices.size(),fp) ==
+         lods[i].indices.size();
+  ok = ok && fwrite(meshlets.data(),sizeof(Meshlet),meshlets.size(),fp) == meshlets.size();
+  ok = fclose(fp) == 0 && ok;
+  std::error_code ec;
+  if (ok)
+    std::filesystem::rename(tmp,name,ec);
+  if (!ok || ec) {
+    std::filesystem::remove(tmp,ec);
+    std::cerr << "Could not write mesh cache: " << name << std::endl;
+    return false;
+  }
+  return true;
+}
+
+MeshCache::MeshCache (MappedFilePtr file)
+: m_file(file),
+  m_header(reinterpret_cast<const Header*>(file->GetData()))
+{
+  // levels follow the table, in order
+  const char* data = m_file->GetData();
+  size_t offset = LODTable(data,m_header->nverts,m_header->nindices) - data +
+                  m_header->nlods*sizeof(LODEntry);
+  for (unsigned int i=0; i<GetLODCount(); ++i) {
+    m_lod_offsets.push_back(offset);
+    offset += size_t(GetLODIndexCount(i))*sizeof(unsigned int);
+  }
+  // then the meshlets
+  m_meshlet_offset = offset;
+}
+
+MeshCache::~MeshCache ()
+{
+}
+
+unsigned int MeshCache::GetVertexCount () const
+{
+  return m_header->nverts;
+}
+
+unsigned int MeshCache::GetIndexCount () const
+{
+  return m_header->nindices;
+}
+
+const Geometry::Vertex* MeshCache::GetVertices () const
+{
+  return reinterpret_cast<const Geometry::Vertex*>(m_file->GetData() + DATA_OFFSET);
+}
+
+const unsigned int* MeshCache::GetIndices () const
+{
+  return reinterpret_cast<const unsigned int*>(m_file->GetData() + DATA_OFFSET +
+                                               size_t(m_header->nverts)*sizeof(Geometry::Vertex));
+}
+
+Bounds MeshCache::GetBounds () const
+{
+  return Bounds(glm::vec3(m_header->bmin[0],m_header->bmin[1],m_header->bmin[2]),
+                glm::vec3(m_header->bmax[0],m_header->bmax[1],m_header->bmax[2]));
+}
+
+unsigned int MeshCache::GetLODCount () const
+{
+  return m_header->nlods;
+}
+
+unsigned int MeshCache::GetLODIndexCount (unsigned int lod) const
+{
+  const LODEntry* table = reinterpret_cast<const LODEntry*>(
+    LODTable(m_file->GetData(),m_header->nverts,m_header->nindices));
+  return table[lod].nindices;
+}
+
+float MeshCache::GetLODError (unsigned int lod) const
+{
+  const LODEntry* table = reinterpret_cast<const LODEntry*>(
+    LODTable(m_file->GetData(),m_header->nverts,m_header->nindices));
+  return table[lod].error;
+}
+
+const unsigned int* MeshCache::GetLODIndices (unsigned int lod) const
+{
+  return reinterpret_cast<const unsigned int*>(m_file->GetData() + m_lod_offsets[lod]);
+}
+
+unsigned int MeshCache::GetMeshletCount () const
+{
+  return m_header->nmeshlets;
+}
+
+const Meshlet* MeshCache::GetMeshlets () const
+{
+  return reinterpret_cast<const Meshlet*>(m_file->GetData() + m_meshlet_offset);
+}
@@ -0,0 +1,84 @@
+#include <memory>
+class MeshCache;
+using MeshCachePtr = std::shared_ptr<MeshCache>; 
+
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include "mappedfile.h"
+#include "geometry.h"
+#include "meshsimplifier.h"
+#include "meshlets.h"
+#include "bounds.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary sidecar of a mesh file ("<file>.bin"): a header followed by the
+// interleaved vertices (Geometry::Vertex), the indices and the levels of
+// detail (a table of counts and errors, then their indices) and the
+// meshlets, ready to be uploaded from the mapped pages. The header
+// records size, modification time and content hash of the source; a
+// cache whose source changed is ignored (and rewritten by the caller).
+#define MESH_CACHE_MAX_LODS 8
+
+class MeshCache {
+  struct Header {
+    char magic[4];           // "MSHB"
+    uint32_t version;
+    uint32_t vertex_size;    // sizeof(Geometry::Vertex)
+    uint32_t nverts;
+    uint32_t nindices;
+    uint32_t flags;          // processing applied to the data
+    uint64_t source_size;
+    int64_t source_time;
+    uint64_t source_hash;
+    float bmin[3];
+    float bmax[3];
+    uint32_t nlods;
+    float lod_ratios[MESH_CACHE_MAX_LODS];   // requested, to validate the cache
+    uint32_t nmeshlets;      // over the indices (MESHLETS)
+  };
+  struct LODEntry {
+    uint32_t nindices;
+    float error;
+  };
+  MappedFilePtr m_file;
+  const Header* m_header;
+  std::vector<size_t> m_lod_offsets;
+  size_t m_meshlet_offset;
+protected:
+  MeshCache (MappedFilePtr file);
+public:
+  enum FLAGS {
+    OPTIMIZED = 1,   // reordered by MeshOptimizer
+    MESHLETS = 2     // indices grouped in meshlets
+  };
+  // cache of the source file if present, up to date and built with the
+  // same flags and LOD ratios, or nullptr
+  static MeshCachePtr Open (const std::string& source, unsigned int flags=0,
+                            const std::vector<float>& lod_ratios=std::vector<float>());
+  // write the cache of the source file; returns false on failure
+  static bool Write (const std::string& source, unsigned int flags,
+                     const Geometry::Vertex* verts, unsigned int nverts,
+                     const unsigned int* indices, unsigned int nindices,
+                     const Bounds& bounds,
+                     const std::vector<float>& lod_ratios=std::vector<float>(),
+                     const std::vector<MeshSimplifier::LOD>& lods=std::vector<MeshSimplifier::LOD>(),
+                     const std::vector<Meshlet>& meshlets=std::vector<Meshlet>());
+  static std::string GetCacheName (const std::string& source);
+  virtual ~MeshCache ();
+  unsigned int GetVertexCount () const;
+  unsigned int GetIndexCount () const;
+  const Geometry::Vertex* GetVertices () const;
+  const unsigned int* GetIndices () const;
+  Bounds GetBounds () const;
+  unsigned int GetLODCount () const;
+  unsigned int GetLODIndexCount (unsigned int lod) const;
+  float GetLODError (unsigned int lod) const;
+  const unsigned int* GetLODIndices (unsigned int lod) const;
+  unsigned int GetMeshletCount () const;
+  const Meshlet* GetMeshlets () const;
+};
+
+#endif
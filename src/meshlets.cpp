@@ -0,0 +1,145 @@
+#include "meshlets.h"
+
+#include <algorithm>
+#include <cmath>
+
+// bounding sphere (center of the box, farthest vertex) and normal cone
+static void ComputeBounds (Meshlet& m, const std::vector<Geometry::Vertex>& verts,
+                           const unsigned int* tris, const unsigned int* mverts, unsigned int nverts)
+{
+  glm::vec3 bmin = verts[mverts[0]].coord, bmax = bmin;
+  for (unsigned int i=1; i<nverts; ++i) {
+    bmin = glm::min(bmin,verts[mverts[i]].coord);
+    bmax = glm::max(bmax,verts[mverts[i]].coord);
+  }
+  glm::vec3 center = 0.5f*(bmin+bmax);
+  float radius = 0.0f;
+  for (unsigned int i=0; i<nverts; ++i)
+    radius = std::max(radius,glm::length(verts[mverts[i]].coord-center));
+  m.sphere = glm::vec4(center,radius);
+  // axis as the mean normal; the cone spans the normal farthest from it
+  std::vector<glm::vec3> normals;
+  normals.reserve(m.count/3);
+  glm::vec3 axis(0.0f);
+  for (unsigned int t=0; t<m.count; t+=3) {
+    const glm::vec3& p0 = verts[tris[t]].coord;
+    glm::vec3 n = glm::cross(verts[tris[t+1]].coord-p0,verts[tris[t+2]].coord-p0);
+    float len = glm::length(n);
+    if (len == 0.0f)
+      continue;
+    normals.push_back(n/len);
+    axis += n/len;
+  }
+  float len = glm::length(axis);
+  m.cone = glm::vec4(0.0f,0.0f,1.0f,1.0f);
+  if (normals.empty() || len < 1e-6f)
+    return;
+  axis /= len;
+  float mindp = 1.0f;
+  for (const glm::vec3& n : normals)
+    mindp = std::min(mindp,glm::dot(n,axis));
+  // wider than a hemisphere: some triangle always faces the eye
+  m.cone = glm::vec4(axis,mindp <= 0.0f ? 1.0f : std::sqrt(1.0f-mindp*mindp));
+}
+
+std::vector<Meshlet> Meshlets::Build (const std::vector<Geometry::Vertex>& verts,
+                                      std::vector<unsigned int>& indices,
+                                      unsigned int max_verts, unsigned int max_tris)
+{
+  std::vector<Meshlet> meshlets;
+  unsigned int nverts = (unsigned int)verts.size();
+  unsigned int ntris = (unsigned int)(indices.size()/3);
+  if (ntris == 0 || max_verts < 3 || max_tris == 0)
+    return meshlets;
+  // vertex -> triangles adjacency (compressed rows)
+  std::vector<unsigned int> offset(nverts+1,0), adjacency(3*ntris);
+  for (unsigned int i=0; i<3*ntris; ++i)
+    offset[indices[i]+1]++;
+  for (unsigned int v=0; v<nverts; ++v)
+    offset[v+1] += offset[v];
+  {
+    std::vector<unsigned int> fill(offset.begin(),offset.end()-1);
+    for (unsigned int i=0; i<3*ntris; ++i)
+      adjacency[fill[indices[i]]++] = i/3;
+  }
+  std::vector<unsigned int> reordered;
+  reordered.reserve(3*ntris);
+  std::vector<char> emitted(ntris,0);
+  // meshlet of the vertex (+1) / candidate triangle (+1), by stamp
+  std::vector<unsigned int> vstamp(nverts,0), tstamp(ntris,0);
+  std::vector<unsigned int> mverts, candidates;
+  mverts.reserve(max_verts);
+  unsigned int seed = 0;
+  while (true) {
+    while (seed < ntris && emitted[seed])
+      seed++;
+    if (seed == ntris)
+      break;
+    unsigned int stamp = (unsigned int)meshlets.size()+1;
+    Meshlet m;
+    m.first = (unsigned int)reordered.size();
+    mverts.clear();
+    candidates.clear();
+    candidates.push_back(seed);
+    tstamp[seed] = stamp;
+    unsigned int count = 0;
+    while (count < max_tris) {
+      // adjacent triangle adding the fewest vertices
+      int best = -1;
+      unsigned int best_new = 4;
+      size_t n = 0;
+      for (size_t i=0; i<candidates.size(); ++i) {
+        unsigned int t = candidates[i];
+        if (emitted[t])
+          continue;
+        candidates[n++] = t;
+        unsigned int nnew = (vstamp[indices[3*t]] != stamp) + (vstamp[indices[3*t+1]] != stamp) +
+                            (vstamp[indices[3*t+2]] != stamp);
+        if (nnew < best_new && mverts.size()+nnew <= max_verts) {
+          best = (int)(n-1);
+          best_new = nnew;
+        }
+      }
+      candidates.resize(n);
+      if (best < 0)
+        break;
+      unsigned int t = candidates[best];
+      emitted[t] = 1;
+      count++;
+      for (int k=0; k<3; ++k) {
+        unsigned int v = indices[3*t+k];
+        reordered.push_back(v);
+        if (vstamp[v] == stamp)
+          continue;
+        vstamp[v] = stamp;
+        mverts.push_back(v);
+        for (unsigned int i=offset[v]; i<offset[v+1]; ++i) {
+          unsigned int a = adjacency[i];
+          if (!emitted[a] && tstamp[a] != stamp) {
+            tstamp[a] = stamp;
+            candidates.push_back(a);
+          }
+        }
+      }
+    }
+    m.count = 3*count;
+    ComputeBounds(m,verts,&reordered[m.first],mverts.data(),(unsigned int)mverts.size());
+    meshlets.push_back(m);
+  }
+  // degenerate remainders (fewer than 3 indices) are kept at the end
+  reordered.insert(reordered.end(),indices.begin()+3*ntris,indices.end());
+  indices.swap(reordered);
+  return meshlets;
+}
+
+bool Meshlets::IsCulled (const Meshlet& m, const Frustum& frustum, const glm::vec3* eye)
+{
+  glm::vec3 center(m.sphere);
+  if (!frustum.Intersects(center,m.sphere.w))
+    return true;
+  if (!eye || m.cone.w >= 1.0f)
+    return false;
+  // every normal faces away from any eye direction to the sphere
+  glm::vec3 d = center - *eye;
+  return glm::dot(d,glm::vec3(m.cone)) >= m.cone.w*glm::length(d) + m.sphere.w;
+}
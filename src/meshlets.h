@@ -0,0 +1,36 @@
+#ifndef MESHLETS_H
+#define MESHLETS_H
+
+#include "geometry.h"
+#include "frustum.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// Cluster of triangles, contiguous in the index buffer, with the bounds
+// used to cull it: a sphere and a cone containing the triangle normals
+struct Meshlet {
+  unsigned int first;       // first index
+  unsigned int count;       // number of indices
+  glm::vec4 sphere;         // (center, radius)
+  glm::vec4 cone;           // (axis, sine of the cone angle; 1: never back facing)
+};
+
+// Splitting of indexed triangle meshes into meshlets (done once, at load
+// time) and cluster culling in object space.
+class Meshlets {
+public:
+  // reorders the triangles so that each meshlet is contiguous; meshlets
+  // grow over shared vertices, starting from the triangles in order
+  static std::vector<Meshlet> Build (const std::vector<Geometry::Vertex>& verts,
+                                     std::vector<unsigned int>& indices,
+                                     unsigned int max_verts=MESHLET_MAX_VERTICES,
+                                     unsigned int max_tris=MESHLET_MAX_TRIANGLES);
+  // outside the frustum, or entirely back facing from the eye position
+  // (nullptr: no back face test)
+  static bool IsCulled (const Meshlet& m, const Frustum& frustum, const glm::vec3* eye);
+};
+
+#endif
@@ -0,0 +1,229 @@
+#include "meshoptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define CACHE_SIZE 16   // post-transform cache entries assumed
+
+static unsigned int CacheMisses (const std::vector<unsigned int>& indices, unsigned int nverts)
+{
+  // FIFO: a vertex is cached while fewer than CACHE_SIZE misses followed it
+  std::vector<unsigned int> stamp(nverts,0);
+  unsigned int misses = 0;
+  for (unsigned int v : indices) {
+    if (v >= nverts)
+      continue;
+    if (stamp[v] == 0 || misses - stamp[v] + 1 > CACHE_SIZE) {
+      misses++;
+      stamp[v] = misses;
+    }
+  }
+  return misses;
+}
+
+float MeshOptimizer::ACMR (const std::vector<unsigned int>& indices, unsigned int nverts)
+{
+  size_t ntris = indices.size()/3;
+  return ntris ? float(CacheMisses(indices,nverts))/float(ntris) : 0.0f;
+}
+
+float MeshOptimizer::ATVR (const std::vector<unsigned int>& indices, unsigned int nverts)
+{
+  std::vector<char> used(nverts,0);
+  unsigned int nused = 0;
+  for (unsigned int v : indices)
+    if (v < nverts && !used[v]) {
+      used[v] = 1;
+      nused++;
+    }
+  return nused ? float(CacheMisses(indices,nverts))/float(nused) : 0.0f;
+}
+
+// Tipsify: fan around a vertex, then continue from the candidate that is
+// still in cache and has the most live triangles; dead ends start a new
+// cluster (its first triangle is recorded in clusters)
+void MeshOptimizer::OptimizeVertexCache (std::vector<unsigned int>& indices, unsigned int nverts,
+                                         std::vector<unsigned int>* clusters)
+{
+  unsigned int ntris = (unsigned int)(indices.size()/3);
+  if (clusters)
+    clusters->clear();
+  if (ntris == 0 || nverts == 0)
+    return;
+  // vertex -> triangles adjacency (compressed rows)
+  std::vector<unsigned int> live(nverts,0);
+  for (unsigned int v : indices)
+    live[v]++;
+  std::vector<unsigned int> offset(nverts+1,0);
+  for (unsigned int v=0; v<nverts; ++v)
+    offset[v+1] = offset[v] + live[v];
+  std::vector<unsigned int> adjacency(indices.size());
+  std::vector<unsigned int> fill(offset.begin(),offset.end()-1);
+  for (unsigned int t=0; t<ntris; ++t)
+    for (int k=0; k<3; ++k)
+      adjacency[fill[indices[3*t+k]]++] = t;
+
+  std::vector<unsigned int> stamp(nverts,0);
+  std::vector<char> emitted(ntris,0);
+  std::vector<unsigned int> deadend;
+  std::vector<unsigned int> candidates;
+  std::vector<unsigned int> output;
+  output.reserve(indices.size());
+  unsigned int time = CACHE_SIZE+1;
+  unsigned int cursor = 0;
+  int fan = 0;
+  bool boundary = true;
+  while (fan >= 0) {
+    candidates.clear();
+    for (unsigned int a=offset[fan]; a<offset[fan+1]; ++a) {
+      unsigned int t = adjacency[a];
+      if (emitted[t])
+        continue;
+      if (boundary && clusters)
+        clusters->push_back((unsigned int)(output.size()/3));
+      boundary = false;
+      for (int k=0; k<3; ++k) {
+        unsigned int v = indices[3*t+k];
+        output.push_back(v);
+        deadend.push_back(v);
+        candidates.push_back(v);
+        live[v]--;
+        if (time - stamp[v] > CACHE_SIZE)
+          stamp[v] = time++;
+      }
+      emitted[t] = 1;
+    }
+    // next fanning vertex
+    int best = -1;
+    int priority = -1;
+    for (unsigned int v : candidates) {
+      if (live[v] == 0)
+        continue;
+      int p = 0;
+      if (time - stamp[v] + 2*live[v] <= CACHE_SIZE)
+        p = int(time - stamp[v]);
+      if (p > priority) {
+        priority = p;
+        best = int(v);
+      }
+    }
+    if (best < 0) {
+      boundary = true;
+      while (!deadend.empty()) {
+        unsigned int v = deadend.back();
+        deadend.pop_back();
+        if (live[v] > 0) {
+          best = int(v);
+          break;
+        }
+      }
+      while (best < 0 && cursor < nverts) {
+        if (live[cursor] > 0)
+          best = int(cursor);
+        cursor++;
+      }
+    }
+    fan = best;
+  }
+  indices.swap(output);
+}
+
+// Clusters ordered by how much they face outwards: likely occluders first
+void MeshOptimizer::OptimizeOverdraw (std::vector<unsigned int>& indices,
+                                      const std::vector<Geometry::Vertex>& verts,
+                                      const std::vector<unsigned int>& clusters,
+                                      float threshold)
+{
+  unsigned int ntris = (unsigned int)(indices.size()/3);
+  if (clusters.size() < 2)
+    return;
+  // mesh centroid (area weighted)
+  glm::vec3 center(0.0f);
+  float area = 0.0f;
+  std::vector<glm::vec3> normals(ntris);
+  std::vector<glm::vec3> centroids(ntris);
+  for (unsigned int t=0; t<ntris; ++t) {
+    const glm::vec3& a = verts[indices[3*t+0]].coord;
+    const glm::vec3& b = verts[indices[3*t+1]].coord;
+    const glm::vec3& c = verts[indices[3*t+2]].coord;
+    normals[t] = glm::cross(b-a,c-a);   // length is twice the area
+    centroids[t] = (a+b+c)/3.0f;
+    float w = glm::length(normals[t]);
+    center += centroids[t]*w;
+    area += w;
+  }
+  if (area > 0.0f)
+    center /= area;
+  struct Cluster {
+    unsigned int first, count;
+    float key;
+  };
+  std::vector<Cluster> sorted(clusters.size());
+  for (size_t i=0; i<clusters.size(); ++i) {
+    Cluster& cl = sorted[i];
+    cl.first = clusters[i];
+    cl.count = (i+1 < clusters.size() ? clusters[i+1] : ntris) - cl.first;
+    glm::vec3 c(0.0f), n(0.0f);
+    float w = 0.0f;
+    for (unsigned int t=cl.first; t<cl.first+cl.count; ++t) {
+      float wt = glm::length(normals[t]);
+      c += centroids[t]*wt;
+      n += normals[t];
+      w += wt;
+    }
+    float len = glm::length(n);
+    cl.key = (w > 0.0f && len > 0.0f) ? glm::dot(c/w-center,n/len) : 0.0f;
+  }
+  std::stable_sort(sorted.begin(),sorted.end(),[](const Cluster& a, const Cluster& b) {
+    return a.key > b.key;
+  });
+  std::vector<unsigned int> output;
+  output.reserve(indices.size());
+  for (const Cluster& cl : sorted)
+    output.insert(output.end(),indices.begin()+3*cl.first,indices.begin()+3*(cl.first+cl.count));
+  // keep the cache order if sorting hurts it too much
+  unsigned int nverts = (unsigned int)verts.size();
+  if (ACMR(output,nverts) <= threshold*ACMR(indices,nverts))
+    indices.swap(output);
+}
+
+void MeshOptimizer::OptimizeVertexFetch (std::vector<Geometry::Vertex>& verts,
+                                         std::vector<unsigned int>& indices)
+{
+  const unsigned int UNUSED = ~0u;
+  std::vector<unsigned int> remap(verts.size(),UNUSED);
+  std::vector<Geometry::Vertex> output;
+  output.reserve(verts.size());
+  for (unsigned int& v : indices) {
+    if (remap[v] == UNUSED) {
+      remap[v] = (unsigned int)output.size();
+      output.push_back(verts[v]);
+    }
+    v = remap[v];
+  }
+  verts.swap(output);   // unreferenced vertices are dropped
+}
+
+MeshOptimizer::Stats MeshOptimizer::Optimize (std::vector<Geometry::Vertex>& verts,
+                                              std::vector<unsigned int>& indices)
+{
+  Stats st;
+  unsigned int nverts = (unsigned int)verts.size();
+  // indices out of range are dropped with their triangle
+  std::vector<unsigned int> valid;
+  valid.reserve(indices.size());
+  for (size_t t=0; t+2<indices.size(); t+=3)
+    if (indices[t] < nverts && indices[t+1] < nverts && indices[t+2] < nverts)
+      valid.insert(valid.end(),indices.begin()+t,indices.begin()+t+3);
+  indices.swap(valid);
+  st.acmr_before = ACMR(indices,nverts);
+  st.atvr_before = ATVR(indices,nverts);
+  std::vector<unsigned int> clusters;
+  OptimizeVertexCache(indices,nverts,&clusters);
+  OptimizeOverdraw(indices,verts,clusters);
+  OptimizeVertexFetch(verts,indices);
+  nverts = (unsigned int)verts.size();
+  st.acmr_after = ACMR(indices,nverts);
+  st.atvr_after = ATVR(indices,nverts);
+  return st;
+}
@@ -0,0 +1,33 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include "geometry.h"
+#include <vector>
+
+// Reordering of indexed triangle meshes (done once, at load time):
+// - vertex cache: Tipsify (Sander, Nehab, Barczak 2007), linear time;
+// - overdraw: the Tipsify clusters are sorted from the outside in,
+//   unless that costs more than a small ACMR increase;
+// - vertex fetch: vertices renumbered in order of first use.
+class MeshOptimizer {
+public:
+  struct Stats {
+    float acmr_before, acmr_after;   // cache misses per triangle
+    float atvr_before, atvr_after;   // cache misses per vertex
+  };
+  static void OptimizeVertexCache (std::vector<unsigned int>& indices, unsigned int nverts,
+                                   std::vector<unsigned int>* clusters=nullptr);
+  static void OptimizeOverdraw (std::vector<unsigned int>& indices,
+                                const std::vector<Geometry::Vertex>& verts,
+                                const std::vector<unsigned int>& clusters,
+                                float threshold=1.05f);
+  static void OptimizeVertexFetch (std::vector<Geometry::Vertex>& verts,
+                                   std::vector<unsigned int>& indices);
+  // all of the above
+  static Stats Optimize (std::vector<Geometry::Vertex>& verts, std::vector<unsigned int>& indices);
+  // simulated FIFO post-transform cache
+  static float ACMR (const std::vector<unsigned int>& indices, unsigned int nverts);
+  static float ATVR (const std::vector<unsigned int>& indices, unsigned int nverts);
+};
+
+#endif
@@ -0,0 +1,264 @@
+#include "meshsimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+// symmetric 4x4 matrix (upper triangle) and the total weight of its planes
+struct Quadric {
+  double a00, a01, a02, a03, a11, a12, a13, a22, a23, a33;
+  double w;
+};
+
+static void AddPlane (Quadric& q, double a, double b, double c, double d, double w)
+{
+  q.a00 += w*a*a; q.a01 += w*a*b; q.a02 += w*a*c; q.a03 += w*a*d;
+  q.a11 += w*b*b; q.a12 += w*b*c; q.a13 += w*b*d;
+  q.a22 += w*c*c; q.a23 += w*c*d;
+  q.a33 += w*d*d;
+  q.w += w;
+}
+
+static void Add (Quadric& q, const Quadric& r)
+{
+  q.a00 += r.a00; q.a01 += r.a01; q.a02 += r.a02; q.a03 += r.a03;
+  q.a11 += r.a11; q.a12 += r.a12; q.a13 += r.a13;
+  q.a22 += r.a22; q.a23 += r.a23;
+  q.a33 += r.a33;
+  q.w += r.w;
+}
+
+// weighted sum of squared distances of p to the planes
+static double Eval (const Quadric& q, const glm::vec3& p)
+{
+  double x = p.x, y = p.y, z = p.z;
+  return q.a00*x*x + 2*q.a01*x*y + 2*q.a02*x*z + 2*q.a03*x +
+         q.a11*y*y + 2*q.a12*y*z + 2*q.a13*y +
+         q.a22*z*z + 2*q.a23*z + q.a33;
+}
+
+static glm::vec3 Cross (const glm::vec3& a, const glm::vec3& b)
+{
+  return glm::vec3(a.y*b.z-a.z*b.y,a.z*b.x-a.x*b.z,a.x*b.y-a.y*b.x);
+}
+
+static float Dot (const glm::vec3& a, const glm::vec3& b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+static uint64_t EdgeKey (unsigned int a, unsigned int b)
+{
+  return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+}
+
+// first vertex with the same position
+static std::vector<unsigned int> PositionRemap (const std::vector<Geometry::Vertex>& verts)
+{
+  struct Hash {
+    size_t operator() (const glm::vec3& p) const
+    {
+      uint32_t h[3];
+      memcpy(h,&p.x,sizeof(h));
+      return (h[0]*73856093u) ^ (h[1]*19349663u) ^ (h[2]*83492791u);
+    }
+  };
+  struct Equal {
+    bool operator() (const glm::vec3& a, const glm::vec3& b) const
+    {
+      return a.x == b.x && a.y == b.y && a.z == b.z;
+    }
+  };
+  std::unordered_map<glm::vec3,unsigned int,Hash,Equal> first;
+  first.reserve(verts.size());
+  std::vector<unsigned int> remap(verts.size());
+  for (unsigned int i=0; i<verts.size(); ++i)
+    remap[i] = first.emplace(verts[i].coord,i).first->second;
+  return remap;
+}
+
+struct Collapse {
+  unsigned int from;     // vertex removed (single wedge)
+  unsigned int to;       // wedge it is replaced by
+  double cost;
+};
+
+std::vector<unsigned int> MeshSimplifier::Simplify (const std::vector<Geometry::Vertex>& verts,
+                                                    const std::vector<unsigned int>& indices,
+                                                    unsigned int target_count, float* error)
+{
+  unsigned int nverts = (unsigned int)verts.size();
+  std::vector<unsigned int> pos = PositionRemap(verts);
+  // working copy without out of range or degenerate triangles
+  std::vector<unsigned int> tris;
+  tris.reserve(indices.size());
+  for (size_t i=0; i+2<indices.size(); i+=3) {
+    unsigned int a = indices[i], b = indices[i+1], c = indices[i+2];
+    if (a >= nverts || b >= nverts || c >= nverts ||
+        pos[a] == pos[b] || pos[b] == pos[c] || pos[a] == pos[c])
+      continue;
+    tris.push_back(a);
+    tris.push_back(b);
+    tris.push_back(c);
+  }
+  // lock seams, borders and non-manifold edges
+  std::vector<char> locked(nverts,0);
+  std::vector<unsigned int> wedges(nverts,0);
+  for (unsigned int i=0; i<nverts; ++i)
+    wedges[pos[i]]++;
+  for (unsigned int i=0; i<nverts; ++i)
+    if (wedges[pos[i]] > 1)
+      locked[pos[i]] = 1;
+  std::unordered_map<uint64_t,unsigned int> edges;
+  edges.reserve(tris.size());
+  for (size_t t=0; t<tris.size(); t+=3)
+    for (int k=0; k<3; ++k)
+      edges[EdgeKey(pos[tris[t+k]],pos[tris[t+(k+1)%3]])]++;
+  for (const auto& e : edges)
+    if (e.second != 2) {
+      locked[unsigned(e.first >> 32)] = 1;
+      locked[unsigned(e.first & 0xffffffffu)] = 1;
+    }
+  // area weighted plane quadrics (by position)
+  std::vector<Quadric> quadrics(nverts);
+  memset(quadrics.data(),0,nverts*sizeof(Quadric));
+  for (size_t t=0; t<tris.size(); t+=3) {
+    const glm::vec3& p0 = verts[tris[t]].coord;
+    glm::vec3 n = Cross(verts[tris[t+1]].coord-p0,verts[tris[t+2]].coord-p0);
+    float len = std::sqrt(Dot(n,n));
+    if (len == 0.0f)
+      continue;
+    n = n/len;
+    double d = -Dot(n,p0);
+    for (int k=0; k<3; ++k)
+      AddPlane(quadrics[pos[tris[t+k]]],n.x,n.y,n.z,d,0.5*len);
+  }
+
+  unsigned int target_tris = target_count/3;
+  double max_cost = 0.0;
+  std::vector<unsigned int> remap(nverts);
+  std::vector<char> touched(nverts);
+  std::vector<unsigned int> offset(nverts+1), adjacency;
+  std::vector<Collapse> candidates;
+  while (tris.size()/3 > target_tris) {
+    // position -> triangles adjacency (compressed rows)
+    std::fill(offset.begin(),offset.end(),0);
+    for (unsigned int v : tris)
+      offset[pos[v]+1]++;
+    for (unsigned int v=0; v<nverts; ++v)
+      offset[v+1] += offset[v];
+    adjacency.resize(tris.size());
+    {
+      std::vector<unsigned int> fill(offset.begin(),offset.end()-1);
+      for (size_t i=0; i<tris.size(); ++i)
+        adjacency[fill[pos[tris[i]]]++] = (unsigned int)(i/3);
+    }
+    // cheapest direction of each interior edge (seen once, from a < b)
+    candidates.clear();
+    for (size_t t=0; t<tris.size(); t+=3)
+      for (int k=0; k<3; ++k) {
+        unsigned int wa = tris[t+k], wb = tris[t+(k+1)%3];
+        unsigned int a = pos[wa], b = pos[wb];
+        if (a > b || (locked[a] && locked[b]))
+          continue;
+        Quadric q = quadrics[a];
+        Add(q,quadrics[b]);
+        double w = q.w > 0.0 ? q.w : 1.0;
+        double ca = std::max(0.0,Eval(q,verts[wb].coord))/w;   // a onto b
+        double cb = std::max(0.0,Eval(q,verts[wa].coord))/w;   // b onto a
+        if (locked[b] || (!locked[a] && ca <= cb))
+          candidates.push_back({wa,wb,ca});
+        else
+          candidates.push_back({wb,wa,cb});
+      }
+    if (candidates.empty())
+      break;
+    std::sort(candidates.begin(),candidates.end(),
+              [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+    // greedy independent collapses, about two triangles each
+    unsigned int need = (unsigned int)(tris.size()/3 - target_tris + 1)/2;
+    for (unsigned int v=0; v<nverts; ++v)
+      remap[v] = v;
+    std::fill(touched.begin(),touched.end(),0);
+    unsigned int done = 0;
+    for (const Collapse& c : candidates) {
+      if (done >= need)
+        break;
+      unsigned int u = pos[c.from], v = pos[c.to];
+      if (touched[u] || touched[v])
+        continue;
+      // reject collapses that flip a remaining triangle around u
+      const glm::vec3& pv = verts[c.to].coord;
+      bool flips = false;
+      for (unsigned int i=offset[u]; i<offset[u+1] && !flips; ++i) {
+        const unsigned int* tri = &tris[3*adjacency[i]];
+        glm::vec3 p[3];
+        int ku = -1;
+        bool shared = false;
+        for (int j=0; j<3; ++j) {
+          unsigned int w = remap[tri[j]];
+          if (pos[w] == v)
+            shared = true;
+          if (pos[w] == u)
+            ku = j;
+          p[j] = verts[w].coord;
+        }
+        if (shared || ku < 0)
+          continue;
+        glm::vec3 n0 = Cross(p[1]-p[0],p[2]-p[0]);
+        p[ku] = pv;
+        glm::vec3 n1 = Cross(p[1]-p[0],p[2]-p[0]);
+        flips = Dot(n0,n1) <= 0.25f*std::sqrt(Dot(n0,n0)*Dot(n1,n1));
+      }
+      if (flips)
+        continue;
+      remap[c.from] = c.to;
+      touched[u] = touched[v] = 1;
+      Add(quadrics[v],quadrics[u]);
+      max_cost = std::max(max_cost,c.cost);
+      done++;
+    }
+    if (done == 0)
+      break;
+    // apply, dropping the triangles that collapsed
+    size_t n = 0;
+    for (size_t t=0; t<tris.size(); t+=3) {
+      unsigned int a = remap[tris[t]], b = remap[tris[t+1]], c = remap[tris[t+2]];
+      if (pos[a] == pos[b] || pos[b] == pos[c] || pos[a] == pos[c])
+        continue;
+      tris[n++] = a;
+      tris[n++] = b;
+      tris[n++] = c;
+    }
+    tris.resize(n);
+  }
+  if (error)
+    *error = float(std::sqrt(max_cost));
+  return tris;
+}
+
+std::vector<MeshSimplifier::LOD> MeshSimplifier::BuildLODs (const std::vector<Geometry::Vertex>& verts,
+                                                            const std::vector<unsigned int>& indices,
+                                                            const std::vector<float>& ratios)
+{
+  std::vector<LOD> lods;
+  lods.reserve(ratios.size());
+  size_t ntris = indices.size()/3;
+  float error = 0.0f;
+  for (float ratio : ratios) {
+    const std::vector<unsigned int>& source = lods.empty() ? indices : lods.back().indices;
+    unsigned int target = 3*(unsigned int)(ratio*float(ntris));
+    if (target >= source.size())
+      continue;
+    float e;
+    std::vector<unsigned int> lod = Simplify(verts,source,target,&e);
+    if (lod.empty() || lod.size() >= source.size())
+      break;
+    // errors of consecutive levels add up
+    error += e;
+    lods.push_back({std::move(lod),error});
+  }
+  return lods;
+}
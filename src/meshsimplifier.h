@@ -0,0 +1,30 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include "geometry.h"
+#include <vector>
+
+// Edge collapse simplification driven by quadric error metrics (Garland,
+// Heckbert 1997). Vertices are collapsed onto their neighbors, never
+// moved, so the results are index buffers over the source vertices.
+// Vertices on borders, seams (same position with different attributes)
+// and non-manifold edges are kept in place.
+class MeshSimplifier {
+public:
+  struct LOD {
+    std::vector<unsigned int> indices;
+    float error;    // bound of the distance to the source surface (object space)
+  };
+  // indices of about target_count (a multiple of 3) or fewer, when possible;
+  // error gets the distance of the worst collapse
+  static std::vector<unsigned int> Simplify (const std::vector<Geometry::Vertex>& verts,
+                                             const std::vector<unsigned int>& indices,
+                                             unsigned int target_count, float* error=nullptr);
+  // chain of levels at decreasing triangle ratios of the source, each one
+  // simplified from the previous; levels that do not reduce it are dropped
+  static std::vector<LOD> BuildLODs (const std::vector<Geometry::Vertex>& verts,
+                                     const std::vector<unsigned int>& indices,
+                                     const std::vector<float>& ratios);
+};
+
+#endif
@@ -0,0 +1,212 @@
+#include "mshparser.h"
+
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#define MIN_CHUNK (256*1024)   // smaller files are not worth a thread
+
+static inline bool IsSpace (char c)
+{
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+static inline const char* SkipSpace (const char* p, const char* end)
+{
+  while (p < end && IsSpace(*p))
+    ++p;
+  return p;
+}
+
+static inline const char* SkipToken (const char* p, const char* end)
+{
+  while (p < end && !IsSpace(*p))
+    ++p;
+  return p;
+}
+
+static inline const char* ReadFloat (const char* p, const char* end, float* v)
+{
+  p = SkipSpace(p,end);
+#if defined(__cpp_lib_to_chars)
+  std::from_chars_result r = std::from_chars(p,end,*v);
+  if (r.ec != std::errc())
+    *v = 0.0f;
+  return SkipToken(r.ptr,end);
+#else
+  // no floating-point from_chars: the mapping is not null terminated
+  char buf[64];
+  const char* q = SkipToken(p,end);
+  size_t n = size_t(q-p) < sizeof(buf)-1 ? size_t(q-p) : sizeof(buf)-1;
+  memcpy(buf,p,n);
+  buf[n] = '\0';
+  *v = strtof(buf,nullptr);
+  return q;
+#endif
+}
+
+static inline const char* ReadIndex (const char* p, const char* end, unsigned int* v)
+{
+  p = SkipSpace(p,end);
+  std::from_chars_result r = std::from_chars(p,end,*v);
+  if (r.ec != std::errc())
+    *v = 0;
+  return SkipToken(r.ptr,end);
+}
+
+// Records are a tag followed by 3 numbers; other characters are skipped,
+// as in the former stream based reader
+template <class F>
+static void Scan (const char* p, const char* end, F&& record)
+{
+  for (;;) {
+    p = SkipSpace(p,end);
+    if (p >= end)
+      return;
+    char c = *p++;
+    if (c == 'V' || c == 'N' || c == 'T')
+      p = record(c,p);
+  }
+}
+
+MshParserPtr MshParser::Make (const std::string& filename, int nthreads)
+{
+  return MshParserPtr(new MshParser(filename,nthreads));
+}
+
+MshParser::MshParser (const std::string& filename, int nthreads)
+: m_file(MappedFile::Make(filename)),
+  m_nv(0), m_nn(0), m_nt(0)
+{
+  if (nthreads <= 0)
+    nthreads = int(std::thread::hardware_concurrency());
+  if (nthreads <= 0)
+    nthreads = 1;
+  const char* data = m_file->GetData();
+  size_t size = m_file->GetSize();
+  size_t nchunks = size / MIN_CHUNK + 1;
+  if (nchunks > size_t(nthreads))
+    nchunks = size_t(nthreads);
+  // split at line boundaries
+  const char* begin = data;
+  const char* end = data + size;
+  for (size_t i=0; i<nchunks && begin < end; ++i) {
+    const char* stop = i+1 == nchunks ? end : data + size*(i+1)/nchunks;
+    if (stop < begin)
+      stop = begin;
+    while (stop < end && *stop != '\n')
+      ++stop;
+    Chunk chunk = {begin,stop,0,0,0,0,0,0};
+    m_chunks.push_back(chunk);
+    begin = stop;
+  }
+  // count records of each chunk
+  auto count = [](Chunk* chunk) {
+    Scan(chunk->begin,chunk->end,[chunk](char c, const char* p) {
+      const char* end = chunk->end;
+      if (c == 'V')
+        chunk->nv++;
+      else if (c == 'N')
+        chunk->nn++;
+      else
+        chunk->nt++;
+      for (int k=0; k<3; ++k)
+        p = SkipToken(SkipSpace(p,end),end);
+      return p;
+    });
+  };
+  std::vector<std::thread> threads;
+  for (size_t i=1; i<m_chunks.size(); ++i)
+    threads.emplace_back(count,&m_chunks[i]);
+  if (!m_chunks.empty())
+    count(&m_chunks[0]);
+  for (std::thread& t : threads)
+    t.join();
+  for (Chunk& chunk : m_chunks) {
+    chunk.fv = m_nv;
+    chunk.fn = m_nn;
+    chunk.ft = m_nt;
+    m_nv += chunk.nv;
+    m_nn += chunk.nn;
+    m_nt += chunk.nt;
+  }
+}
+
+MshParser::~MshParser ()
+{
+}
+
+unsigned int MshParser::GetVertexCount () const
+{
+  return m_nv;
+}
+
+unsigned int MshParser::GetNormalCount () const
+{
+  return m_nn;
+}
+
+unsigned int MshParser::GetTriangleCount () const
+{
+  return m_nt;
+}
+
+size_t MshParser::GetFileSize () const
+{
+  return m_file->GetSize();
+}
+
+Bounds MshParser::Parse (Geometry::Vertex* verts, unsigned int* indices) const
+{
+  std::vector<Bounds> bounds(m_chunks.size());
+  auto parse = [verts,indices,this](const Chunk* chunk, Bounds* b) {
+    Geometry::Vertex* v = verts + chunk->fv;
+    Geometry::Vertex* n = verts + chunk->fn;
+    unsigned int* t = indices + 3*size_t(chunk->ft);
+    Geometry::Vertex* vend = verts + m_nv;
+    const char* end = chunk->end;
+    Scan(chunk->begin,end,[&](char c, const char* p) {
+      if (c == 'V') {
+        glm::vec3 x;
+        p = ReadFloat(p,end,&x.x);
+        p = ReadFloat(p,end,&x.y);
+        p = ReadFloat(p,end,&x.z);
+        // normals are written by their own records
+        v->coord = x;
+        v->tangent = glm::vec3(0.0f);
+        v->texcoord = glm::vec2(0.0f);
+        b->Merge(x);
+        ++v;
+      }
+      else if (c == 'N') {
+        glm::vec3 x;
+        p = ReadFloat(p,end,&x.x);
+        p = ReadFloat(p,end,&x.y);
+        p = ReadFloat(p,end,&x.z);
+        if (n < vend)    // extra normals are ignored
+          n->normal = x;
+        ++n;
+      }
+      else {
+        p = ReadIndex(p,end,t++);
+        p = ReadIndex(p,end,t++);
+        p = ReadIndex(p,end,t++);
+      }
+      return p;
+    });
+  };
+  std::vector<std::thread> threads;
+  for (size_t i=1; i<m_chunks.size(); ++i)
+    threads.emplace_back(parse,&m_chunks[i],&bounds[i]);
+  if (!m_chunks.empty())
+    parse(&m_chunks[0],&bounds[0]);
+  for (std::thread& t : threads)
+    t.join();
+  for (unsigned int i=m_nn; i<m_nv; ++i)
+    verts[i].normal = glm::vec3(0.0f);
+  Bounds box;
+  for (const Bounds& b : bounds)
+    box.Merge(b);
+  return box;
+}
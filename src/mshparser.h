@@ -0,0 +1,46 @@
+#include <memory>
+class MshParser;
+using MshParserPtr = std::shared_ptr<MshParser>; 
+
+#ifndef MSH_PARSER_H
+#define MSH_PARSER_H
+
+#include "mappedfile.h"
+#include "geometry.h"
+#include "bounds.h"
+#include <string>
+#include <vector>
+
+// Parser of .msh files, made of "V x y z" (vertex), "N x y z" (normal)
+// and "T i j k" (triangle) records. The file is memory mapped and split
+// at line boundaries into chunks that are scanned in parallel, twice:
+// Make counts the records of each chunk, so Parse knows where each
+// record goes and writes it straight to its final position (e.g. a
+// mapped GPU buffer).
+class MshParser {
+  struct Chunk {
+    const char* begin;
+    const char* end;
+    unsigned int nv, nn, nt;   // records in the chunk
+    unsigned int fv, fn, ft;   // first record of each kind (prefix sums)
+  };
+  MappedFilePtr m_file;
+  std::vector<Chunk> m_chunks;
+  unsigned int m_nv, m_nn, m_nt;
+protected:
+  MshParser (const std::string& filename, int nthreads);
+public:
+  // nthreads = 0 uses all hardware threads
+  static MshParserPtr Make (const std::string& filename, int nthreads=0);
+  virtual ~MshParser ();
+  unsigned int GetVertexCount () const;
+  unsigned int GetNormalCount () const;
+  unsigned int GetTriangleCount () const;
+  size_t GetFileSize () const;
+  // fill verts (GetVertexCount entries) and indices (3*GetTriangleCount);
+  // vertices without a normal record get a null normal.
+  // returns the bounds of the vertex coordinates
+  Bounds Parse (Geometry::Vertex* verts, unsigned int* indices) const;
+};
+
+#endif
@@ -13,6 +13,10 @@
 #endif
 #include <iostream>
 
+static unsigned int s_structure_version = 0;
+static unsigned int s_transform_version = 0;
+static unsigned int s_shape_version = 0;
+
 Node::Node (ShaderPtr shader, TransformPtr trf, 
             std::initializer_list<AppearancePtr> apps,
             std::initializer_list<ShapePtr> shps
@@ -22,8 +26,17 @@ Node::Node (ShaderPtr shader, TransformPtr trf,
   m_trf(trf),
   m_apps(apps),
   m_shps(shps),
-  m_nodes()
+  m_lods(shps.size(),-1),
+  m_nodes(),
+  m_world(1.0f),
+  m_dirty(true),
+  m_bounds(),
+  m_nshapes(0),
+  m_bounds_dirty(true),
+  m_shape_version(s_shape_version)
 {
+  if (m_trf)
+    m_trf->AttachNode(this);
 }
 NodePtr Node::Make (ShaderPtr shader, 
                     TransformPtr trf, 
@@ -187,70 +200,190 @@ NodePtr Node::Make (TransformPtr trf,
 
 Node::~Node () 
 {
+  if (m_trf)
+    m_trf->DetachNode(this);
 }
 
 void Node::SetShader (ShaderPtr shader)
 {
   m_shader = shader;
+  s_structure_version++;
 }
 void Node::SetTransform (TransformPtr trf)
 {
+  if (m_trf)
+    m_trf->DetachNode(this);
   m_trf = trf;
+  if (m_trf)
+    m_trf->AttachNode(this);
+  Invalidate();
 }
 void Node::AddAppearance (AppearancePtr app)
 {
   m_apps.push_back(app);
+  s_structure_version++;
 }
 void Node::AddShape (ShapePtr shp)
 {
   m_shps.push_back(shp);
+  m_lods.push_back(-1);
+  InvalidateBounds();
+  s_structure_version++;
 }
 void Node::AddNode (NodePtr node)
 {
   m_nodes.push_back(node);
   node->SetParent(shared_from_this());
+  InvalidateBounds();
+  s_structure_version++;
 }
 void Node::SetParent (NodePtr parent)
 {
   m_parent = parent;
+  Invalidate();
 }
 NodePtr Node::GetParent () const
 {
   return m_parent.lock();
 }
+ShaderPtr Node::GetShader () const
+{
+  return m_shader;
+}
+const std::vector<AppearancePtr>& Node::GetAppearances () const
+{
+  return m_apps;
+}
+const std::vector<ShapePtr>& Node::GetShapes () const
+{
+  return m_shps;
+}
+const std::vector<NodePtr>& Node::GetNodes () const
+{
+  return m_nodes;
+}
+unsigned int Node::GetStructureVersion ()
+{
+  return s_structure_version;
+}
+unsigned int Node::GetTransformVersion ()
+{
+  return s_transform_version;
+}
+void Node::InvalidateStructure ()
+{
+  s_structure_version++;
+}
+void Node::InvalidateShapes ()
+{
+  s_shape_version++;
+  s_structure_version++;
+}
 glm::mat4 Node::GetMatrix () const
 {
   return m_trf ? m_trf->GetMatrix() : glm::mat4(1.0f);
 }
-glm::mat4 Node::GetModelMatrix () 
+const glm::mat4& Node::GetModelMatrix () 
+{
+  if (m_dirty) {
+    NodePtr parent = GetParent();
+    m_world = parent ? parent->GetModelMatrix() * GetMatrix() : GetMatrix();
+    m_dirty = false;
+  }
+  return m_world;
+}
+void Node::Invalidate ()
+{
+  s_transform_version++;
+  InvalidateMatrix();
+  // the bounds of the ancestors depend on this subtree
+  NodePtr parent = GetParent();
+  if (parent)
+    parent->InvalidateBounds();
+}
+void Node::InvalidateMatrix ()
+{
+  // a dirty node always has dirty descendants, so stop early
+  if (m_dirty)
+    return;
+  m_dirty = true;
+  m_bounds_dirty = true;
+  for (NodePtr& node : m_nodes)
+    node->InvalidateMatrix();
+}
+void Node::InvalidateBounds ()
 {
-  glm::mat4 mat = GetMatrix();
-  NodePtr node = GetParent();
-  while (node != nullptr) {
-    mat = node->GetMatrix() * mat;
-    node = node->GetParent();
-  } 
-  return mat;
+  // a node with dirty bounds always has dirty ancestors, so stop early
+  if (m_bounds_dirty)
+    return;
+  m_bounds_dirty = true;
+  NodePtr parent = GetParent();
+  if (parent)
+    parent->InvalidateBounds();
+}
+void Node::UpdateBounds ()
+{
+  const glm::mat4& mat = GetModelMatrix();
+  m_bounds = Bounds();
+  m_nshapes = (unsigned int)m_shps.size();
+  for (ShapePtr& shp : m_shps)
+    m_bounds.Merge(shp->GetBounds().Transformed(mat));
+  for (NodePtr& node : m_nodes) {
+    m_bounds.Merge(node->GetWorldBounds());
+    m_nshapes += node->m_nshapes;
+  }
+  m_bounds_dirty = false;
+  m_shape_version = s_shape_version;
+}
+const Bounds& Node::GetWorldBounds ()
+{
+  if (m_bounds_dirty || m_shape_version != s_shape_version)
+    UpdateBounds();
+  return m_bounds;
+}
+unsigned int Node::GetShapeCount ()
+{
+  if (m_bounds_dirty)
+    UpdateBounds();
+  return m_nshapes;
 }
 void Node::Render (StatePtr st) 
 {
+  // reject the whole subtree when outside the view frustum
+  if (st->IsCulling()) {
+    if (!st->GetFrustum().Intersects(GetWorldBounds())) {
+      st->AddCulled(GetShapeCount());
+      return;
+    }
+    st->AddVisible((unsigned int)m_shps.size());
+  }
   // load
   if (m_shader) 
     m_shader->Load(st);
   if (m_trf) 
     m_trf->Load(st);
-  for (AppearancePtr app : m_apps)
+  for (const AppearancePtr& app : m_apps)
     app->Load(st);
   // draw
   if (!m_shps.empty()) {
     st->LoadMatrices();
-    for (ShapePtr shp : m_shps)
-      shp->Draw(st);
+    for (size_t i=0; i<m_shps.size(); ++i) {
+      Shape* shp = m_shps[i].get();
+      if (shp->GetLODCount() == 1) {
+        shp->Draw(st);
+        continue;
+      }
+      // hysteresis from the level of this draw (shapes are shared among
+      // nodes), as RenderList keeps it per draw record
+      float unit_size = st->GetProjectedUnitSize(st->GetCurrentMatrix(),shp->GetBoundingSphere());
+      m_lods[i] = shp->SelectLOD(unit_size,m_lods[i]);
+      shp->DrawLOD(st,m_lods[i]);
+    }
   }
-  for (NodePtr node : m_nodes)
+  for (const NodePtr& node : m_nodes)
     node->Render(st);
   // unload in reverse order
-  for (AppearancePtr app : m_apps)
+  for (const AppearancePtr& app : m_apps)
     app->Unload(st);
   if (m_trf)
     m_trf->Unload(st);
@@ -6,6 +6,7 @@ using NodePtr = std::shared_ptr<Node>;
 #define NODE_H
 
 #include "appearance.h"
+#include "bounds.h"
 #include "node.h"
 #include "shader.h"
 #include "shape.h"
@@ -21,7 +22,17 @@ class Node : public std::enable_shared_from_this<Node>
   TransformPtr m_trf;                 // associated transformation
   std::vector<AppearancePtr> m_apps;  // associated appearances
   std::vector<ShapePtr> m_shps;       // associated shapes
+  std::vector<int> m_lods;            // per shape: level of the last recursive draw (-1: none)
   std::vector<NodePtr> m_nodes;       // child nodes
+  glm::mat4 m_world;                  // cached model (world) matrix
+  bool m_dirty;                       // cached model matrix out of date
+  Bounds m_bounds;                    // cached world bounds of the subtree
+  unsigned int m_nshapes;             // number of shapes in the subtree
+  bool m_bounds_dirty;                // cached bounds out of date
+  unsigned int m_shape_version;       // shape version of the cached bounds
+  void InvalidateMatrix ();
+  void InvalidateBounds ();
+  void UpdateBounds ();
 protected:
   Node (ShaderPtr shader=nullptr,
         TransformPtr trf=nullptr, 
@@ -100,9 +111,26 @@ public:
   void AddNode (NodePtr node);
   void SetParent (NodePtr parent);
   NodePtr GetParent () const;
+  ShaderPtr GetShader () const;
+  const std::vector<AppearancePtr>& GetAppearances () const;
+  const std::vector<ShapePtr>& GetShapes () const;
+  const std::vector<NodePtr>& GetNodes () const;
   glm::mat4 GetMatrix () const;
-  glm::mat4 GetModelMatrix ();
+  const glm::mat4& GetModelMatrix ();
+  void Invalidate ();
+  const Bounds& GetWorldBounds ();
+  unsigned int GetShapeCount ();
   void Render (StatePtr st);
+  // incremented whenever any node gains a shader, appearance, shape or child
+  static unsigned int GetStructureVersion ();
+  // incremented whenever any node matrix is invalidated
+  static unsigned int GetTransformVersion ();
+  // something compiled lists depend on changed outside the graph (e.g. a
+  // material became translucent): lists are rebuilt
+  static void InvalidateStructure ();
+  // shapes changed their bounds (e.g. finished loading): every cached
+  // bound and compiled list is rebuilt
+  static void InvalidateShapes ();
 };
 
 #endif
\ No newline at end of file
@@ -24,14 +24,14 @@ PolygonOffset::~PolygonOffset ()
 {
 }
 
-void PolygonOffset::Load (StatePtr )
+void PolygonOffset::Load (StatePtr st)
 {
   glPolygonOffset(m_factor,m_units);
-  glEnable(GL_POLYGON_OFFSET_FILL);
-  glEnable(GL_POLYGON_OFFSET_LINE);
+  st->Enable(GL_POLYGON_OFFSET_FILL);
+  st->Enable(GL_POLYGON_OFFSET_LINE);
 }
-void PolygonOffset::Unload (StatePtr )
+void PolygonOffset::Unload (StatePtr st)
 {
-  glDisable(GL_POLYGON_OFFSET_LINE);
-  glDisable(GL_POLYGON_OFFSET_FILL);
+  st->Disable(GL_POLYGON_OFFSET_LINE);
+  st->Disable(GL_POLYGON_OFFSET_FILL);
 }
\ No newline at end of file
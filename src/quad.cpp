@@ -1,8 +1,9 @@
 #include "quad.h"
 #include "error.h"
-#include "grid.h"
+#include "geometry.h"
 
 #include <iostream>
+#include <vector>
 
 #ifdef _WIN32
 //#define GLAD_GL_IMPLEMENTATION // Necessary for headeronly version.
@@ -20,35 +21,45 @@ QuadPtr Quad::Make (int nx, int ny)
 
 Quad::Quad (int nx, int ny)
 {
-  GridPtr grid = Grid::Make(nx,ny);
-  m_nind = grid->IndexCount();
-  // create VAO
-  glGenVertexArrays(1,&m_vao);
-  glBindVertexArray(m_vao);
-  // create coord buffer
-  GLuint id;
-  glGenBuffers(1,&id);
-  glBindBuffer(GL_ARRAY_BUFFER,id);
-  glBufferData(GL_ARRAY_BUFFER,2*grid->VertexCount()*sizeof(float),grid->GetCoords(),GL_STATIC_DRAW);
-  glVertexAttribPointer(0,2,GL_FLOAT,GL_FALSE,0,0);  // coord
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(3,2,GL_FLOAT,GL_FALSE,0,0);  // texcoord
-  glEnableVertexAttribArray(3);
-  // create index buffer
-  GLuint index;
-  glGenBuffers(1,&index);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,index);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER,m_nind*sizeof(unsigned int),grid->GetIndices(),GL_STATIC_DRAW);
+  std::string key = "quad:" + std::to_string(nx) + "x" + std::to_string(ny);
+  m_geom = Geometry::Find(key);
+  if (!m_geom && Geometry::IsProcedural())
+    m_geom = Geometry::MakeProcedural(key,Geometry::PROC_QUAD,nx,ny);
+  if (!m_geom) {
+    // grid (u,v) serve as both coord and texcoord
+    GridPtr grid = Geometry::GetGrid(nx,ny);
+    std::vector<Geometry::Vertex> verts(grid->VertexCount());
+    const float* coords = grid->GetCoords();
+    for (int i=0; i<grid->VertexCount(); ++i) {
+      verts[i].coord = glm::vec3(coords[2*i+0],coords[2*i+1],0.0f);
+      verts[i].normal = glm::vec3(0.0f,0.0f,1.0f);
+      verts[i].tangent = glm::vec3(1.0f,0.0f,0.0f);
+      verts[i].texcoord = glm::vec2(coords[2*i+0],coords[2*i+1]);
+    }
+    m_geom = Geometry::Make(key,verts,nx,ny);
+  }
 }
 
 Quad::~Quad () 
 {
 }
 
-void Quad::Draw (StatePtr )
+void Quad::Draw (StatePtr st)
 {
-  glBindVertexArray(m_vao);
-  glVertexAttrib3f(1,0.0f,0.0f,1.0f); // constant for all vertices
-  glVertexAttrib3f(2,1.0f,0.0f,0.0f); // constant for all vertices
-  glDrawElements(GL_TRIANGLES,m_nind,GL_UNSIGNED_INT,0);
-}
\ No newline at end of file
+  m_geom->Draw(st);
+}
+
+bool Quad::CanDrawInstanced () const
+{
+  return true;
+}
+
+void Quad::DrawInstanced (StatePtr st, int ninstances)
+{
+  m_geom->DrawInstanced(st,ninstances);
+}
+
+Bounds Quad::GetBounds () const
+{
+  return Bounds(glm::vec3(0.0f,0.0f,0.0f),glm::vec3(1.0f,1.0f,0.0f));
+}
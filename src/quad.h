@@ -6,15 +6,18 @@ using QuadPtr = std::shared_ptr<Quad>;
 #define QUAD_H
 
 #include "shape.h"
+#include "geometry.h"
 
 class Quad : public Shape {
-  unsigned int m_vao;
-  unsigned int m_nind; // number of incident vertices
+  GeometryPtr m_geom;
 protected:
   Quad (int nx, int ny);
 public:
   static QuadPtr Make (int nx=1, int ny=1);
   virtual ~Quad ();
   virtual void Draw (StatePtr st);
+  virtual Bounds GetBounds () const;
+  virtual bool CanDrawInstanced () const;
+  virtual void DrawInstanced (StatePtr st, int ninstances);
 };
 #endif
\ No newline at end of file
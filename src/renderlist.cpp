@@ -0,0 +1,429 @@
+#include "renderlist.h"
+#include "node.h"
+#include "shader.h"
+#include "shape.h"
+#include "appearance.h"
+#include "material.h"
+#include "texture.h"
+#include "camera.h"
+#include "state.h"
+#include "error.h"
+
+#ifdef _WIN32
+//#define GLAD_GL_IMPLEMENTATION // Necessary for headeronly version.
+#include <glad/gl.h>
+#elif __APPLE__
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+
+// State key layout (39 bits): shader (11) | texture set (16) | material (12)
+#define SHADER_BITS   11
+#define TEXSET_BITS   16
+#define MATERIAL_BITS 12
+#define DEPTH_BITS    24
+
+// minimum number of records worth an instanced draw
+#define MIN_INSTANCES 2
+// minimum number of records for culling through a BVH
+#define BVH_MIN_RECORDS 64
+
+RenderListPtr RenderList::Make (NodePtr root)
+{
+  return RenderListPtr(new RenderList(root));
+}
+
+RenderList::RenderList (NodePtr root)
+: m_root(root),
+  m_version(0),
+  m_trf_version(0),
+  m_sorted(false),
+  m_instanced(false),
+  m_records(),
+  m_apps(),
+  m_inst_buffer(0),
+  m_inst_tex(0)
+{
+  Build();
+}
+
+RenderList::~RenderList ()
+{
+  if (m_inst_tex) {
+    glDeleteTextures(1,&m_inst_tex);
+    glDeleteBuffers(1,&m_inst_buffer);
+  }
+}
+
+void RenderList::SetSorted (bool sorted)
+{
+  m_sorted = sorted;
+}
+
+bool RenderList::IsSorted () const
+{
+  return m_sorted;
+}
+
+void RenderList::SetInstanced (bool instanced)
+{
+  if (instanced != m_instanced) {
+    m_instanced = instanced;
+    Build();
+  }
+}
+
+bool RenderList::IsInstanced () const
+{
+  return m_instanced;
+}
+
+const std::vector<DrawBatch>& RenderList::GetBatches () const
+{
+  return m_batches;
+}
+
+void RenderList::Build ()
+{
+  m_records.clear();
+  m_apps.clear();
+  m_shader_ids.clear();
+  m_texset_ids.clear();
+  m_material_ids.clear();
+  std::vector<Appearance*> apps;
+  Compile(m_root.get(),nullptr,apps);
+  BuildBatches();
+  BuildBVH();
+  m_version = Node::GetStructureVersion();
+  m_trf_version = Node::GetTransformVersion();
+}
+
+void RenderList::BuildBVH ()
+{
+  m_bvh = nullptr;
+  m_item_first.clear();
+  m_item_count.clear();
+  if (m_order.size() < BVH_MIN_RECORDS)
+    return;
+  // records of a node are contiguous: one item per node
+  std::vector<Node*> nodes;
+  for (unsigned int j=0; j<m_order.size(); ++j) {
+    Node* node = m_records[m_order[j]].node;
+    if (nodes.empty() || nodes.back() != node) {
+      nodes.push_back(node);
+      m_item_first.push_back(j);
+      m_item_count.push_back(0);
+    }
+    m_item_count.back()++;
+  }
+  m_bvh = BVH::Make(nodes);
+}
+
+void RenderList::BuildBatches ()
+{
+  m_batches.clear();
+  m_order.clear();
+  std::vector<bool> batched(m_records.size(),false);
+  if (m_instanced) {
+    // group opaque records by shader, shape and appearance sequence
+    using BatchKey = std::tuple<Shader*,Shape*,std::vector<Appearance*>>;
+    std::map<BatchKey,unsigned int> groups;
+    std::vector<DrawBatch> candidates;
+    for (unsigned int i=0; i<m_records.size(); ++i) {
+      const DrawRecord& rec = m_records[i];
+      Shader* shader = rec.shader->GetInstancedShader().get();
+      if (!shader || rec.transparent || !rec.shape->CanDrawInstanced())
+        continue;
+      BatchKey key(rec.shader,rec.shape,
+                   std::vector<Appearance*>(m_apps.begin()+rec.app_first,
+                                            m_apps.begin()+rec.app_first+rec.app_count));
+      auto it = groups.emplace(key,(unsigned int)candidates.size());
+      if (it.second)
+        candidates.push_back(DrawBatch{shader,rec.shape,rec.app_first,rec.app_count,{}});
+      candidates[it.first->second].records.push_back(i);
+    }
+    for (DrawBatch& batch : candidates) {
+      if (batch.records.size() < MIN_INSTANCES)
+        continue;
+      for (unsigned int i : batch.records)
+        batched[i] = true;
+      m_batches.push_back(batch);
+    }
+    // submit batches in state order
+    std::sort(m_batches.begin(),m_batches.end(),[this](const DrawBatch& a, const DrawBatch& b) {
+      return m_records[a.records[0]].state_key < m_records[b.records[0]].state_key;
+    });
+  }
+  for (unsigned int i=0; i<m_records.size(); ++i)
+    if (!batched[i])
+      m_order.push_back(i);
+}
+
+void RenderList::Compile (Node* node, Shader* shader, std::vector<Appearance*>& apps)
+{
+  if (node->GetShader())
+    shader = node->GetShader().get();
+  size_t napps = apps.size();
+  for (const AppearancePtr& app : node->GetAppearances())
+    apps.push_back(app.get());
+  // nodes drawn without a shader are skipped (as they cannot load matrices)
+  if (shader && !node->GetShapes().empty()) {
+    unsigned int first = (unsigned int)m_apps.size();
+    m_apps.insert(m_apps.end(),apps.begin(),apps.end());
+    bool transparent;
+    uint64_t key = MakeStateKey(shader,first,(unsigned int)apps.size(),&transparent);
+    for (const ShapePtr& shp : node->GetShapes()) {
+      DrawRecord rec;
+      rec.matrix = node->GetModelMatrix();
+      rec.node = node;
+      rec.shader = shader;
+      rec.app_first = first;
+      rec.app_count = (unsigned int)apps.size();
+      rec.shape = shp.get();
+      rec.state_key = key;
+      rec.transparent = transparent;
+      rec.sphere = shp->GetBoundingSphere();
+      rec.lod = -1;
+      m_records.push_back(rec);
+    }
+  }
+  for (const NodePtr& child : node->GetNodes())
+    Compile(child.get(),shader,apps);
+  apps.resize(napps);
+}
+
+uint64_t RenderList::MakeStateKey (Shader* shader, unsigned int first, unsigned int count, bool* transparent)
+{
+  // textures are identified by their GL ids; the innermost material wins
+  std::vector<unsigned int> texset;
+  Appearance* material = nullptr;
+  *transparent = false;
+  for (unsigned int i=first; i<first+count; ++i) {
+    if (Texture* tex = dynamic_cast<Texture*>(m_apps[i]))
+      texset.push_back(tex->GetTexId());
+    else if (Material* mat = dynamic_cast<Material*>(m_apps[i])) {
+      material = mat;
+      *transparent = mat->GetOpacity() < 1.0f;
+    }
+  }
+  auto sid = m_shader_ids.emplace(shader,(unsigned int)m_shader_ids.size()).first->second;
+  auto tid = m_texset_ids.emplace(texset,(unsigned int)m_texset_ids.size()).first->second;
+  auto mid = m_material_ids.emplace(material,(unsigned int)m_material_ids.size()).first->second;
+  // ids beyond the field width only degrade the ordering
+  uint64_t key = sid & ((1u<<SHADER_BITS)-1);
+  key = (key << TEXSET_BITS) | (tid & ((1u<<TEXSET_BITS)-1));
+  key = (key << MATERIAL_BITS) | (mid & ((1u<<MATERIAL_BITS)-1));
+  return key;
+}
+
+// Order-preserving 24-bit quantization of a non-negative depth
+static uint64_t QuantizeDepth (float d)
+{
+  if (!(d > 0.0f))
+    return 0;
+  uint32_t bits;
+  memcpy(&bits,&d,sizeof(bits));
+  return bits >> (32-1-DEPTH_BITS);
+}
+
+void RenderList::Sort (StatePtr st)
+{
+  // opaque: state first, then front to back;
+  // transparent: after all opaque geometry, back to front
+  const uint64_t dmax = (uint64_t(1)<<DEPTH_BITS) - 1;
+  glm::mat4 view = st->GetCamera()->GetViewMatrix();
+  m_keys.resize(m_records.size());
+  for (unsigned int i : m_frame) {
+    const DrawRecord& rec = m_records[i];
+    glm::vec4 pos = view * rec.matrix[3];
+    uint64_t depth = QuantizeDepth(-pos.z);
+    if (rec.transparent)
+      m_keys[i] = (uint64_t(1)<<63) | ((dmax-depth) << 39) | rec.state_key;
+    else
+      m_keys[i] = (rec.state_key << DEPTH_BITS) | depth;
+  }
+  std::sort(m_frame.begin(),m_frame.end(),[this](unsigned int a, unsigned int b) {
+    return m_keys[a] < m_keys[b];
+  });
+}
+
+bool RenderList::SameAppearances (const DrawRecord& a, const DrawRecord& b) const
+{
+  if (a.app_first == b.app_first && a.app_count == b.app_count)
+    return true;
+  return a.app_count == b.app_count &&
+         std::equal(m_apps.begin()+a.app_first,m_apps.begin()+a.app_first+a.app_count,
+                    m_apps.begin()+b.app_first);
+}
+
+void RenderList::Update ()
+{
+  if (m_version != Node::GetStructureVersion()) {
+    Build();
+    return;
+  }
+  // transform edits only patch matrices (cached in the nodes)
+  if (m_trf_version == Node::GetTransformVersion())
+    return;
+  for (DrawRecord& rec : m_records)
+    rec.matrix = rec.node->GetModelMatrix();
+  if (m_bvh)
+    m_bvh->Refit();
+  m_trf_version = Node::GetTransformVersion();
+}
+
+const std::vector<DrawRecord>& RenderList::GetRecords () const
+{
+  return m_records;
+}
+
+// Frustum test of the record's bounding sphere (counted in the state)
+bool RenderList::IsVisible (StatePtr st, const DrawRecord& rec) const
+{
+  if (!st->IsCulling())
+    return true;
+  const glm::mat4& m = rec.matrix;
+  glm::vec3 center = glm::vec3(m * glm::vec4(glm::vec3(rec.sphere),1.0f));
+  float scale = glm::max(glm::length(glm::vec3(m[0])),
+                glm::max(glm::length(glm::vec3(m[1])),glm::length(glm::vec3(m[2]))));
+  bool visible = st->GetFrustum().Intersects(center,rec.sphere.w*scale);
+  if (visible)
+    st->AddVisible(1);
+  else
+    st->AddCulled(1);
+  return visible;
+}
+
+// Level of detail of a record, from its projected size; the last level
+// drawn is kept for the hysteresis
+int RenderList::SelectLOD (StatePtr st, DrawRecord& rec)
+{
+  if (rec.shape->GetLODCount() > 1)
+    rec.lod = rec.shape->SelectLOD(st->GetProjectedUnitSize(rec.matrix,rec.sphere),rec.lod);
+  else
+    rec.lod = 0;
+  return rec.lod;
+}
+
+// Visible instances are drawn with one call per level of detail
+void RenderList::RenderBatch (StatePtr st, const DrawBatch& batch)
+{
+  m_inst_visible.clear();
+  for (unsigned int i : batch.records) {
+    if (IsVisible(st,m_records[i])) {
+      SelectLOD(st,m_records[i]);
+      m_inst_visible.push_back(i);
+    }
+  }
+  if (m_inst_visible.empty())
+    return;
+  batch.shader->Load(st);
+  for (unsigned int i=0; i<batch.app_count; ++i)
+    m_apps[batch.app_first+i]->Load(st);
+  int unit = batch.shader->ActiveTexture("instances");
+  if (!m_inst_tex) {
+    glGenBuffers(1,&m_inst_buffer);
+    glGenTextures(1,&m_inst_tex);
+    st->ActiveTexture(unit);
+    st->BindTexture(GL_TEXTURE_BUFFER,m_inst_tex);
+    glBindBuffer(GL_TEXTURE_BUFFER,m_inst_buffer);
+    glTexBuffer(GL_TEXTURE_BUFFER,GL_RGBA32F,m_inst_buffer);
+  }
+  for (int level=0; level<batch.shape->GetLODCount(); ++level) {
+    m_inst_models.clear();
+    for (unsigned int i : m_inst_visible)
+      if (m_records[i].lod == level)
+        m_inst_models.push_back(m_records[i].matrix);
+    if (m_inst_models.empty())
+      continue;
+    st->LoadInstanceMatrices(m_inst_models,m_inst_data);
+    // upload instance matrices into the buffer texture
+    st->ActiveTexture(unit);
+    st->BindTexture(GL_TEXTURE_BUFFER,m_inst_tex);
+    glBindBuffer(GL_TEXTURE_BUFFER,m_inst_buffer);
+    glBufferData(GL_TEXTURE_BUFFER,GLsizeiptr(m_inst_data.size()*sizeof(glm::mat4)),
+                 m_inst_data.data(),GL_STREAM_DRAW);
+    batch.shape->DrawInstancedLOD(st,int(m_inst_models.size()),level);
+  }
+  batch.shader->DeactiveTexture();
+  for (unsigned int i=batch.app_count; i>0; --i)
+    m_apps[batch.app_first+i-1]->Unload(st);
+  batch.shader->Unload(st);
+}
+
+void RenderList::Render (StatePtr st)
+{
+  Update();
+  // select records: through the BVH for large lists, or all of them
+  bool bvh_culled = st->IsCulling() && m_bvh;
+  if (bvh_culled) {
+    m_hits.clear();
+    m_bvh->Query(st->GetFrustum(),m_hits);
+    m_frame.clear();
+    for (unsigned int item : m_hits)
+      for (unsigned int j=0; j<m_item_count[item]; ++j)
+        m_frame.push_back(m_order[m_item_first[item]+j]);
+    st->AddVisible((unsigned int)m_frame.size());
+    st->AddCulled((unsigned int)(m_order.size()-m_frame.size()));
+  }
+  else
+    m_frame.assign(m_order.begin(),m_order.end());
+  if (m_sorted)
+    Sort(st);
+  // instanced batches are opaque: draw them before the single records
+  for (const DrawBatch& batch : m_batches)
+    RenderBatch(st,batch);
+  Shader* shader = nullptr;
+  const DrawRecord* open = nullptr;   // record whose appearances are loaded
+  bool blend = false;
+  for (unsigned int idx : m_frame) {
+    DrawRecord& rec = m_records[idx];
+    if (!bvh_culled && !IsVisible(st,rec))
+      continue;
+    if (m_sorted && rec.transparent && !blend) {
+      st->Enable(GL_BLEND);
+      glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
+      glDepthMask(GL_FALSE);
+      blend = true;
+    }
+    if (!open || open->node != rec.node) {
+      // keep appearances loaded when the next record shares them
+      bool keep = open && open->shader == rec.shader && SameAppearances(*open,rec);
+      if (open && !keep) {
+        // unload in reverse order
+        for (unsigned int i=open->app_count; i>0; --i)
+          m_apps[open->app_first+i-1]->Unload(st);
+      }
+      if (rec.shader != shader) {
+        if (shader)
+          shader->Unload(st);
+        shader = rec.shader;
+        shader->Load(st);
+      }
+      if (!keep) {
+        for (unsigned int i=0; i<rec.app_count; ++i)
+          m_apps[rec.app_first+i]->Load(st);
+      }
+      st->LoadMatrix(rec.matrix);
+      st->LoadMatrices();
+      open = &rec;
+    }
+    rec.shape->DrawLOD(st,SelectLOD(st,rec));
+  }
+  if (open) {
+    for (unsigned int i=open->app_count; i>0; --i)
+      m_apps[open->app_first+i-1]->Unload(st);
+  }
+  if (shader)
+    shader->Unload(st);
+  if (blend) {
+    glDepthMask(GL_TRUE);
+    st->Disable(GL_BLEND);
+  }
+  Error::Check("end render list");
+}
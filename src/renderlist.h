@@ -0,0 +1,91 @@
+#include <memory>
+class RenderList;
+using RenderListPtr = std::shared_ptr<RenderList>; 
+
+#ifndef RENDERLIST_H
+#define RENDERLIST_H
+
+#include "node.h"
+#include "state.h"
+#include "bvh.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Flat draw record compiled from the scene graph: one per shape.
+// Raw pointers are safe because the list keeps the root node alive.
+struct DrawRecord {
+  glm::mat4 matrix;         // model (world) matrix
+  Node* node;               // node that owns the matrix
+  Shader* shader;           // effective shader
+  unsigned int app_first;   // first appearance (in list appearance array)
+  unsigned int app_count;   // number of inherited appearances
+  Shape* shape;
+  uint64_t state_key;       // packed shader/textures/material ids
+  bool transparent;         // material opacity below 1
+  glm::vec4 sphere;         // local bounding sphere of the shape
+  int lod;                  // level of detail last drawn (-1: none)
+};
+
+// Records sharing shape, shader and appearances, drawn with one instanced call
+struct DrawBatch {
+  Shader* shader;           // instanced variant of the records' shader
+  Shape* shape;
+  unsigned int app_first;
+  unsigned int app_count;
+  std::vector<unsigned int> records;
+};
+
+class RenderList {
+  NodePtr m_root;
+  unsigned int m_version;            // node structure version at compile time
+  unsigned int m_trf_version;        // node transform version of the matrices
+  bool m_sorted;                     // submit records sorted by state key
+  bool m_instanced;                  // batch repeated records into instanced draws
+  std::vector<DrawRecord> m_records;
+  std::vector<Appearance*> m_apps;   // appearance sets, referenced by records
+  std::vector<uint64_t> m_keys;      // per-frame sort keys
+  std::vector<unsigned int> m_order; // records not batched
+  std::vector<unsigned int> m_frame; // per-frame submission order
+  // spatial index over the nodes of the records not batched (large lists)
+  BVHPtr m_bvh;
+  std::vector<unsigned int> m_item_first;  // per BVH item: range in m_order
+  std::vector<unsigned int> m_item_count;
+  std::vector<unsigned int> m_hits;
+  std::vector<DrawBatch> m_batches;
+  unsigned int m_inst_buffer;        // per-instance matrices (texture buffer)
+  unsigned int m_inst_tex;
+  std::vector<unsigned int> m_inst_visible;  // visible records of a batch
+  std::vector<glm::mat4> m_inst_models;
+  std::vector<glm::mat4> m_inst_data;
+  // id tables used to build state keys
+  std::map<Shader*,unsigned int> m_shader_ids;
+  std::map<std::vector<unsigned int>,unsigned int> m_texset_ids;
+  std::map<Appearance*,unsigned int> m_material_ids;
+protected:
+  RenderList (NodePtr root);
+  void Compile (Node* node, Shader* shader, std::vector<Appearance*>& apps);
+  uint64_t MakeStateKey (Shader* shader, unsigned int first, unsigned int count, bool* transparent);
+  void Sort (StatePtr st);
+  bool SameAppearances (const DrawRecord& a, const DrawRecord& b) const;
+  void BuildBatches ();
+  void BuildBVH ();
+  int SelectLOD (StatePtr st, DrawRecord& rec);
+  void RenderBatch (StatePtr st, const DrawBatch& batch);
+  bool IsVisible (StatePtr st, const DrawRecord& rec) const;
+public:
+  static RenderListPtr Make (NodePtr root);
+  virtual ~RenderList ();
+  void SetSorted (bool sorted);
+  bool IsSorted () const;
+  void SetInstanced (bool instanced);
+  bool IsInstanced () const;
+  const std::vector<DrawBatch>& GetBatches () const;
+  void Build ();
+  void Update ();
+  const std::vector<DrawRecord>& GetRecords () const;
+  void Render (StatePtr st);
+};
+
+#endif
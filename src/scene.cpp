@@ -1,4 +1,5 @@
 #include "scene.h"
+#include "loader.h"
 #include "state.h"
 
 #ifdef _WIN32
@@ -11,7 +12,13 @@
 #endif
 
 Scene::Scene (NodePtr root)
-: m_root(root)
+: m_root(root),
+  m_compiled(false),
+  m_sorted(false),
+  m_instanced(false),
+  m_culling(false),
+  m_list(nullptr),
+  m_state(nullptr)
 {
 }
 
@@ -33,6 +40,57 @@ void Scene::AddEngine (EnginePtr engine)
   m_engines.push_back(engine);
 }
 
+void Scene::SetCompiled (bool compiled)
+{
+  m_compiled = compiled;
+  if (!m_compiled) {
+    m_sorted = false;
+    m_instanced = false;
+    m_list = nullptr;
+  }
+}
+
+bool Scene::IsCompiled () const
+{
+  return m_compiled;
+}
+
+// Sorted submission only applies to the compiled list, so it enables it
+void Scene::SetSorted (bool sorted)
+{
+  m_sorted = sorted;
+  if (m_sorted)
+    m_compiled = true;
+}
+
+bool Scene::IsSorted () const
+{
+  return m_sorted;
+}
+
+// Instancing also works on the compiled list only
+void Scene::SetInstanced (bool instanced)
+{
+  m_instanced = instanced;
+  if (m_instanced)
+    m_compiled = true;
+}
+
+bool Scene::IsInstanced () const
+{
+  return m_instanced;
+}
+
+void Scene::SetCulling (bool culling)
+{
+  m_culling = culling;
+}
+
+bool Scene::IsCulling () const
+{
+  return m_culling;
+}
+
 void Scene::Update (float dt) const
 {
   for (auto e : m_engines)
@@ -41,6 +99,27 @@ void Scene::Update (float dt) const
 
 void Scene::Render (CameraPtr camera)
 {
-  StatePtr st = State::Make(camera);
-  m_root->Render(st);
+  // GL side of background loads, before the state shadow is reset
+  Loader::Update();
+  // the state (and its frame arena) is reused across frames
+  if (!m_state)
+    m_state = State::Make(camera);
+  else
+    m_state->BeginFrame(camera);
+  StatePtr st = m_state;
+  st->SetCulling(m_culling);
+  if (m_compiled) {
+    if (!m_list)
+      m_list = RenderList::Make(m_root);
+    m_list->SetSorted(m_sorted);
+    m_list->SetInstanced(m_instanced);
+    m_list->Render(st);
+  }
+  else
+    m_root->Render(st);
+}
+
+StatePtr Scene::GetState () const
+{
+  return m_state;
 }
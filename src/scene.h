@@ -8,11 +8,18 @@ using ScenePtr = std::shared_ptr<Scene>;
 #include "node.h"
 #include "engine.h"
 #include "state.h"
+#include "renderlist.h"
 
 class Scene : public Node
 {
   NodePtr m_root;
   std::vector<EnginePtr> m_engines;
+  bool m_compiled;           // render from a flat, compiled draw list
+  bool m_sorted;             // sort the compiled list by render state
+  bool m_instanced;          // batch repeated draws of the compiled list
+  bool m_culling;            // view frustum culling
+  RenderListPtr m_list;
+  StatePtr m_state;          // state of the last rendered frame (reused)
 protected:
   Scene (NodePtr root);
 public:
@@ -20,8 +27,17 @@ public:
   ~Scene ();
   NodePtr GetRoot () const;
   void AddEngine (EnginePtr engine);
+  void SetCompiled (bool compiled);
+  bool IsCompiled () const;
+  void SetSorted (bool sorted);
+  bool IsSorted () const;
+  void SetInstanced (bool instanced);
+  bool IsInstanced () const;
+  void SetCulling (bool culling);
+  bool IsCulling () const;
   void Update (float dt) const;
   void Render (CameraPtr camera);
+  StatePtr GetState () const;
 };
 
 #endif
\ No newline at end of file
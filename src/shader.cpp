@@ -29,8 +29,13 @@ ShaderPtr Shader::Make (LightPtr light, const std::string& space)
 Shader::Shader (LightPtr light, const std::string& space)
 : m_texunit(0),
   m_light(light),
-  m_space(space)
+  m_space(space),
+  m_instanced(nullptr),
+  m_linked(false),
+  m_locations()
 {
+  for (int i=0; i<NUNIFORM; ++i)
+    m_uniforms[i] = -1;
   m_pid = glCreateProgram();
   if (m_pid==0) {
     std::cerr << "Could not create shader object";
@@ -68,89 +73,226 @@ void Shader::AttachTesselationShader (const std::string& control, const std::str
 void Shader::Link ()
 {
   LinkProgram(m_pid);
+  BuildUniformTable();
 }  
 
+static const char* s_uniform_names[Shader::NUNIFORM] = {
+  "Mvp", "Mv", "Mn",
+  "cpos",
+  "lpos", "lamb", "ldif", "lspe", "ldir",
+  "useSpot", "spotCutoff", "spotExponent", "att",
+  "mamb", "mdif", "mspe", "mshi", "mopacity",
+  "quantized", "qoffset", "qscale",
+  "procShape", "procNx", "procNy"
+};
+
+void Shader::BuildUniformTable ()
+{
+  // enumerate active uniforms
+  m_linked = false;
+  m_locations.clear();
+  GLint n = 0, maxlen = 0;
+  glGetProgramiv(m_pid,GL_ACTIVE_UNIFORMS,&n);
+  glGetProgramiv(m_pid,GL_ACTIVE_UNIFORM_MAX_LENGTH,&maxlen);
+  std::vector<char> name(maxlen > 0 ? maxlen : 1);
+  for (GLint i=0; i<n; ++i) {
+    GLsizei len = 0;
+    GLint size;
+    GLenum type;
+    glGetActiveUniform(m_pid,GLuint(i),GLsizei(name.size()),&len,&size,&type,name.data());
+    std::string varname(name.data(),len);
+    GLint loc = GetUniformLocation(varname);
+    m_locations[varname] = loc;
+    // arrays are reported as "name[0]": also register the plain name
+    size_t pos = varname.find("[0]");
+    if (pos != std::string::npos && pos+3 == varname.size())
+      m_locations[varname.substr(0,pos)] = loc;
+  }
+  m_linked = true;
+  // resolve engine uniforms
+  for (int i=0; i<NUNIFORM; ++i)
+    m_uniforms[i] = GetUniformLocation(s_uniform_names[i]);
+  for (Slot& slot : m_slots) {
+    slot.loc = GetUniformLocation(slot.name);
+    slot.set = false;
+  }
+}
+
 LightPtr Shader::GetLight () const
 {
   return m_light;
 }
 
+void Shader::SetInstancedShader (ShaderPtr shader)
+{
+  m_instanced = shader;
+}
+
+ShaderPtr Shader::GetInstancedShader () const
+{
+  return m_instanced;
+}
+
 const std::string& Shader::GetLightingSpace () const
 {
   return m_space;
 }
 
+unsigned int Shader::GetProgramId () const
+{
+  return m_pid;
+}
+
 void Shader::UseProgram () const
 {
   glUseProgram(m_pid);
 }
 
 
-void Shader::SetUniform (const std::string& varname, int x) const
+int Shader::GetUniformLocation (const std::string& varname) const
 {
+  if (!m_linked)
+    return glGetUniformLocation(m_pid,varname.c_str());
+  auto it = m_locations.find(varname);
+  if (it != m_locations.end())
+    return it->second;
+  // paths reflection does not report ("name[i]" with i > 0, struct
+  // members): asked once, then cached (-1 included)
   GLint loc = glGetUniformLocation(m_pid,varname.c_str());
-  glUniform1i(loc,x);
+  m_locations[varname] = loc;
+  return loc;
+}
+
+int Shader::GetUniformLocation (UNIFORM u) const
+{
+  return m_uniforms[u];
+}
+
+void Shader::SetUniform (const std::string& varname, int x) const
+{
+  SetUniform(GetUniformLocation(varname),x);
 }
 
 void Shader::SetUniform (const std::string& varname, float x) const
 {
-  GLint loc = glGetUniformLocation(m_pid,varname.c_str());
-  glUniform1f(loc,x);
+  SetUniform(GetUniformLocation(varname),x);
 }
 
 void Shader::SetUniform (const std::string& varname, const glm::vec3& vet) const
 {
-  GLint loc = glGetUniformLocation(m_pid,varname.c_str());
-  glUniform3fv(loc,1,glm::value_ptr(vet));
+  SetUniform(GetUniformLocation(varname),vet);
 }
 
 void Shader::SetUniform (const std::string& varname, const glm::vec4& vet) const
 {
-  GLint loc = glGetUniformLocation(m_pid,varname.c_str());
-  glUniform4fv(loc,1,glm::value_ptr(vet));
+  SetUniform(GetUniformLocation(varname),vet);
 }
 
 void Shader::SetUniform (const std::string& varname, const glm::mat4& mat) const
 {
-  GLint loc = glGetUniformLocation(m_pid,varname.c_str());
-  glUniformMatrix4fv(loc,1,GL_FALSE,glm::value_ptr(mat));
+  SetUniform(GetUniformLocation(varname),mat);
 }
 
 void Shader::SetUniform (const std::string& varname, const std::vector<int>& x) const
 {
-  GLint loc = glGetUniformLocation(m_pid,varname.c_str());
-  glUniform1iv(loc,GLsizei(x.size()),x.data());
+  SetUniform(GetUniformLocation(varname),x);
 }
 
 void Shader::SetUniform (const std::string& varname, const std::vector<float>& x) const
 {
-  GLint loc = glGetUniformLocation(m_pid,varname.c_str());
-  glUniform1fv(loc,GLsizei(x.size()),x.data());
+  SetUniform(GetUniformLocation(varname),x);
 }
 
 void Shader::SetUniform (const std::string& varname, const std::vector<glm::vec3>& vet) const
 {
-  GLint loc = glGetUniformLocation(m_pid,varname.c_str());
-  glUniform3fv(loc,GLsizei(vet.size()),(float*)vet.data());
+  SetUniform(GetUniformLocation(varname),vet);
 }
 
 void Shader::SetUniform (const std::string& varname, const std::vector<glm::vec4>& vet) const
 {
-  GLint loc = glGetUniformLocation(m_pid,varname.c_str());
-  glUniform4fv(loc,GLsizei(vet.size()),(float*)vet.data());
+  SetUniform(GetUniformLocation(varname),vet);
 }
 
 void Shader::SetUniform (const std::string& varname, const std::vector<glm::mat4>& mat) const
 {
-  GLint loc = glGetUniformLocation(m_pid,varname.c_str());
+  SetUniform(GetUniformLocation(varname),mat);
+}
+
+void Shader::SetUniform (int loc, int x) const
+{
+  glUniform1i(loc,x);
+}
+
+void Shader::SetUniform (int loc, float x) const
+{
+  glUniform1f(loc,x);
+}
+
+void Shader::SetUniform (int loc, const glm::vec3& vet) const
+{
+  glUniform3fv(loc,1,glm::value_ptr(vet));
+}
+
+void Shader::SetUniform (int loc, const glm::vec4& vet) const
+{
+  glUniform4fv(loc,1,glm::value_ptr(vet));
+}
+
+void Shader::SetUniform (int loc, const glm::mat4& mat) const
+{
+  glUniformMatrix4fv(loc,1,GL_FALSE,glm::value_ptr(mat));
+}
+
+void Shader::SetUniform (int loc, const std::vector<int>& x) const
+{
+  glUniform1iv(loc,GLsizei(x.size()),x.data());
+}
+
+void Shader::SetUniform (int loc, const std::vector<float>& x) const
+{
+  glUniform1fv(loc,GLsizei(x.size()),x.data());
+}
+
+void Shader::SetUniform (int loc, const std::vector<glm::vec3>& vet) const
+{
+  glUniform3fv(loc,GLsizei(vet.size()),(float*)vet.data());
+}
+
+void Shader::SetUniform (int loc, const std::vector<glm::vec4>& vet) const
+{
+  glUniform4fv(loc,GLsizei(vet.size()),(float*)vet.data());
+}
+
+void Shader::SetUniform (int loc, const std::vector<glm::mat4>& mat) const
+{
   glUniformMatrix4fv(loc,GLsizei(mat.size()),GL_FALSE,(float*)mat.data());
 }
 
-void Shader::ActiveTexture (const std::string& varname)
+int Shader::GetSlot (const std::string& varname)
+{
+  for (size_t i=0; i<m_slots.size(); ++i)
+    if (m_slots[i].name == varname)
+      return int(i);
+  m_slots.push_back(Slot{varname,GetUniformLocation(varname),glm::vec3(0.0f),false});
+  return int(m_slots.size())-1;
+}
+
+void Shader::SetSlot (int slot, const glm::vec3& value)
+{
+  Slot& s = m_slots[slot];
+  if (s.loc < 0 || (s.set && s.value == value))
+    return;
+  SetUniform(s.loc,value);
+  s.value = value;
+  s.set = true;
+}
+
+// Allocates the next texture unit for the sampler and returns it;
+// the caller activates it through the State.
+int Shader::ActiveTexture (const std::string& varname)
 {
   SetUniform(varname,m_texunit);
-  glActiveTexture(GL_TEXTURE0+m_texunit);
-  m_texunit++;
+  return m_texunit++;
 }
 
 void Shader::DeactiveTexture ()
@@ -189,6 +331,31 @@ static std::string ReadFile (const std::string& filename)
   return strStream.str(); //str holds the content of the file
 }
 
+// GLSL has no includes: lines '#include "name"' are replaced by the
+// content of name, relative to the including file; #line keeps the
+// line numbers of compile errors
+static std::string ReadSource (const std::string& filename)
+{
+  std::string source = ReadFile(filename);
+  size_t slash = filename.find_last_of("/\\");
+  std::string dir = slash != std::string::npos ? filename.substr(0,slash+1) : std::string();
+  std::istringstream in(source);
+  std::string out, line;
+  int nline = 0;
+  while (std::getline(in,line)) {
+    ++nline;
+    size_t open = line.find('"');
+    size_t close = line.rfind('"');
+    if (line.compare(0,8,"#include") == 0 && open != std::string::npos && close > open) {
+      out += ReadSource(dir + line.substr(open+1,close-open-1));
+      out += "\n#line " + std::to_string(nline+1) + "\n";
+    }
+    else
+      out += line + "\n";
+  }
+  return out;
+}
+
 static void CompileShader (const std::string& filename, GLuint id)
 {
   GLint status;
@@ -212,7 +379,7 @@ unsigned int Shader::CreateShader (unsigned int shadertype, const std::string& f
     std::cerr << "Could not create shader object";
     exit(1);
   }
-  std::string source = ReadFile(filename);
+  std::string source = ReadSource(filename);
   const char* csource = source.c_str();
   glShaderSource(id, 1, &csource, 0);
   CompileShader(filename,id);
@@ -8,13 +8,39 @@ using ShaderPtr = std::shared_ptr<Shader>;
 #include "light.h"
 #include <glm/glm.hpp>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 class Shader : public std::enable_shared_from_this<Shader> {
+public:
+  // uniforms set by the engine on every draw, resolved once at link time
+  enum UNIFORM {
+    MVP=0, MV, MN,
+    CPOS,
+    LPOS, LAMB, LDIF, LSPE, LDIR,
+    USESPOT, SPOTCUTOFF, SPOTEXPONENT, ATT,
+    MAMB, MDIF, MSPE, MSHI, MOPACITY,
+    QUANTIZED, QOFFSET, QSCALE,
+    PROCSHAPE, PROCNX, PROCNY,
+    NUNIFORM
+  };
+private:
   unsigned int m_pid;
   int m_texunit;
   LightPtr m_light;
   std::string m_space;  // lighting space
+  ShaderPtr m_instanced;  // variant used for instanced draws
+  bool m_linked;
+  mutable std::unordered_map<std::string,int> m_locations;  // active uniforms (reflection), then lookups
+  int m_uniforms[NUNIFORM];                          // indexed engine uniforms
+  struct Slot {
+    std::string name;
+    int loc;
+    glm::vec3 value;   // last uploaded
+    bool set;
+  };
+  std::vector<Slot> m_slots;                         // see GetSlot
+  void BuildUniformTable ();
 protected:
   Shader (LightPtr light, const std::string& space);
 public:
@@ -26,8 +52,13 @@ public:
   void AttachTesselationShader (const std::string& control, const std::string& evaluation);
   void Link ();
   LightPtr GetLight () const;
+  void SetInstancedShader (ShaderPtr shader);
+  ShaderPtr GetInstancedShader () const;
   const std::string& GetLightingSpace () const;
+  unsigned int GetProgramId () const;
   void UseProgram () const;
+  int GetUniformLocation (const std::string& varname) const;
+  int GetUniformLocation (UNIFORM u) const;
   void SetUniform (const std::string& varname, int x) const;
   void SetUniform (const std::string& varname, float x) const;
   void SetUniform (const std::string& varname, const glm::vec3& vet) const;
@@ -38,7 +69,22 @@ public:
   void SetUniform (const std::string& varname, const std::vector<glm::vec3>& vet) const;
   void SetUniform (const std::string& varname, const std::vector<glm::vec4>& vet) const;
   void SetUniform (const std::string& varname, const std::vector<glm::mat4>& mat) const;
-  void ActiveTexture (const std::string& varname);
+  void SetUniform (int loc, int x) const;
+  void SetUniform (int loc, float x) const;
+  void SetUniform (int loc, const glm::vec3& vet) const;
+  void SetUniform (int loc, const glm::vec4& vet) const;
+  void SetUniform (int loc, const glm::mat4& mat) const;
+  void SetUniform (int loc, const std::vector<int>& x) const;
+  void SetUniform (int loc, const std::vector<float>& x) const;
+  void SetUniform (int loc, const std::vector<glm::vec3>& vet) const;
+  void SetUniform (int loc, const std::vector<glm::vec4>& vet) const;
+  void SetUniform (int loc, const std::vector<glm::mat4>& mat) const;
+  // uniforms set by appearances on many draws (e.g. the atlas texel of
+  // textures): resolved once by name, then uploaded only when the value
+  // differs from the last one set on this program
+  int GetSlot (const std::string& varname);
+  void SetSlot (int slot, const glm::vec3& value);
+  int ActiveTexture (const std::string& varname);
   void DeactiveTexture ();  
   void Load (StatePtr st);
   void Unload (StatePtr st);
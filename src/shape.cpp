@@ -0,0 +1,63 @@
+#include "shape.h"
+
+#include <algorithm>
+#include <cfloat>
+
+#define MAX_TESSELLATION_LEVELS 4
+#define MIN_TESSELLATION_SEGMENTS 8
+
+static float s_hysteresis = 0.1f;
+static float s_tolerance = 0.01f;
+
+void Shape::SetLODHysteresis (float fraction)
+{
+  s_hysteresis = fraction;
+}
+
+void Shape::SetTessellationTolerance (float fraction)
+{
+  s_tolerance = fraction;
+}
+
+float Shape::GetLODLimit (int ) const
+{
+  return FLT_MAX;
+}
+
+static int Coarsest (const Shape* shape, float unit_size, float factor)
+{
+  for (int i=shape->GetLODCount()-1; i>0; --i)
+    if (unit_size <= factor*shape->GetLODLimit(i))
+      return i;
+  return 0;
+}
+
+int Shape::SelectLOD (float unit_size, int current) const
+{
+  int level = Coarsest(this,unit_size,1.0f);
+  if (current < 0 || level <= current)
+    return level;   // refine at once
+  return std::max(current,Coarsest(this,unit_size,1.0f-s_hysteresis));
+}
+
+int Shape::SelectLOD (StatePtr st) const
+{
+  if (GetLODCount() == 1)
+    return 0;
+  return SelectLOD(st->GetProjectedUnitSize(st->GetCurrentMatrix(),GetBoundingSphere()));
+}
+
+int Shape::GetTessellationLevels (int nseg)
+{
+  int n = 1;
+  while (n < MAX_TESSELLATION_LEVELS && (nseg >> n) >= MIN_TESSELLATION_SEGMENTS)
+    n++;
+  return n;
+}
+
+// Segments of a circle of radius r projected with unit size u are
+// 2*pi*r*u/nseg long
+float Shape::GetTessellationLimit (int nseg, float radius)
+{
+  return s_tolerance*float(nseg)/(6.28318530718f*radius);
+}
@@ -6,6 +6,8 @@ using ShapePtr = std::shared_ptr<Shape>;
 #define SHAPE_H
 
 #include "state.h"
+#include "bounds.h"
+#include <glm/glm.hpp>
 
 class Shape {
 protected:
@@ -19,6 +21,37 @@ public:
   };
   virtual ~Shape () {}
   virtual void Draw (StatePtr st) = 0;
+  // bounding volumes in local (object) coordinates
+  virtual Bounds GetBounds () const = 0;
+  virtual glm::vec4 GetBoundingSphere () const  // (center, radius)
+  {
+    Bounds b = GetBounds();
+    return glm::vec4(b.GetCenter(),b.GetRadius());
+  }
+  // instanced drawing (per-instance matrices are provided by the caller)
+  virtual bool CanDrawInstanced () const { return false; }
+  virtual void DrawInstanced (StatePtr , int ) { }
+  // levels of detail, 0 being the finest; a level is fine while the
+  // projected size of one object unit (fraction of the viewport height,
+  // see State::GetProjectedUnitSize) does not exceed its limit
+  virtual int GetLODCount () const { return 1; }
+  virtual float GetLODLimit (int level) const;
+  virtual void DrawLOD (StatePtr st, int ) { Draw(st); }
+  virtual void DrawInstancedLOD (StatePtr st, int ninstances, int ) { DrawInstanced(st,ninstances); }
+  // coarsest fine level; moving from the current level (-1: none) to a
+  // coarser one is delayed by the hysteresis
+  int SelectLOD (float unit_size, int current=-1) const;
+  // level for the current matrix of the state
+  int SelectLOD (StatePtr st) const;
+  // fraction of a level limit by which switching to it is delayed (default: 0.1)
+  static void SetLODHysteresis (float fraction);
+  // largest segment length of analytic shapes on screen, as a fraction
+  // of the viewport height (default: 0.01)
+  static void SetTessellationTolerance (float fraction);
+protected:
+  // analytic shapes: levels for a circle of nseg segments, halved per level
+  static int GetTessellationLevels (int nseg);
+  static float GetTessellationLimit (int nseg, float radius);
 };
 
 #endif
\ No newline at end of file
@@ -1,9 +1,11 @@
 #include "sphere.h"
-#include "grid.h"
+#include "geometry.h"
 #include "error.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <vector>
 
 #ifdef _WIN32
 //#define GLAD_GL_IMPLEMENTATION // Necessary for headeronly version.
@@ -21,53 +23,39 @@ SpherePtr Sphere::Make (int nstack, int nslice)
   return SpherePtr(new Sphere(nstack,nslice));
 }
 
+// Registered geometry of one tessellation
+static GeometryPtr Build (int nstack, int nslice)
+{
+  std::string key = "sphere:" + std::to_string(nstack) + "x" + std::to_string(nslice);
+  GeometryPtr geom = Geometry::Find(key);
+  if (!geom && Geometry::IsProcedural())
+    geom = Geometry::MakeProcedural(key,Geometry::PROC_SPHERE,nstack,nslice);
+  if (!geom) {
+    // generate spherical coordinates over the grid
+    GridPtr grid = Geometry::GetGrid(nstack,nslice);
+    std::vector<Geometry::Vertex> verts(grid->VertexCount());
+    const float* texcoord = grid->GetCoords();
+    for (int i=0; i<grid->VertexCount(); ++i) {
+      float theta = texcoord[2*i+0]*2*PI;
+      float phi = texcoord[2*i+1]*PI;
+      Geometry::Vertex& v = verts[i];
+      v.coord = glm::vec3(sin(theta)*sin(PI-phi),cos(PI-phi),cos(theta)*sin(PI-phi));
+      v.normal = v.coord;
+      v.tangent = glm::vec3(cos(theta),0.0f,-sin(theta));
+      v.texcoord = glm::vec2(texcoord[2*i+0],texcoord[2*i+1]);
+    }
+    geom = Geometry::Make(key,verts,nstack,nslice);
+  }
+  return geom;
+}
+
 Sphere::Sphere (int nstack, int nslice)
 {
-  GridPtr grid = Grid::Make(nstack,nslice);
-  m_nind = grid->IndexCount();
-  // generate spherical coordinates
-  float* coord = new float[3*(nstack+1)*(nslice+1)];
-  float* tangent = new float[3*(nstack+1)*(nslice+1)];
-  int nc = 0;
-  const float* texcoord = grid->GetCoords();
-  for (int i=0; i<2*grid->VertexCount(); i+=2) {
-    float theta = texcoord[i+0]*2*PI;
-    float phi = texcoord[i+1]*PI;
-    coord[nc+0] = sin(theta) * sin(PI-phi);
-    coord[nc+1] = cos(PI-phi);
-    coord[nc+2] = cos(theta) * sin(PI-phi);
-    tangent[nc+0] = cos(theta);
-    tangent[nc+1] = 0;
-    tangent[nc+2] = -sin(theta);
-    nc += 3;
+  int nlevels = GetTessellationLevels(nstack);
+  for (int l=0; l<nlevels; ++l) {
+    m_levels.push_back(Build(nstack >> l,std::max(nslice >> l,4)));
+    m_segments.push_back(nstack >> l);
   }
-  // create VAO
-  glGenVertexArrays(1,&m_vao);
-  glBindVertexArray(m_vao);
-  // create buffers
-  GLuint id[3];  // buffers: coord/normal, tangent, texcoord
-  glGenBuffers(3,id);
-  glBindBuffer(GL_ARRAY_BUFFER,id[0]);
-  glBufferData(GL_ARRAY_BUFFER,3*grid->VertexCount()*sizeof(float),coord,GL_STATIC_DRAW);
-  glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,0,0);
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,0,0);
-  glEnableVertexAttribArray(1);
-  glBindBuffer(GL_ARRAY_BUFFER,id[1]);
-  glBufferData(GL_ARRAY_BUFFER,3*grid->VertexCount()*sizeof(float),tangent,GL_STATIC_DRAW);
-  glVertexAttribPointer(2,3,GL_FLOAT,GL_FALSE,0,0);
-  glEnableVertexAttribArray(2);
-  glBindBuffer(GL_ARRAY_BUFFER,id[2]);
-  glBufferData(GL_ARRAY_BUFFER,2*grid->VertexCount()*sizeof(float),texcoord,GL_STATIC_DRAW);
-  glVertexAttribPointer(3,2,GL_FLOAT,GL_FALSE,0,0); 
-  glEnableVertexAttribArray(3);
-  // create index buffer
-  GLuint index;
-  glGenBuffers(1,&index);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,index);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER,m_nind*sizeof(unsigned int),grid->GetIndices(),GL_STATIC_DRAW);
-  delete [] tangent;
-  delete [] coord;
 }
 
 Sphere::~Sphere () 
@@ -76,6 +64,45 @@ Sphere::~Sphere ()
 
 void Sphere::Draw (StatePtr st)
 {
-  glBindVertexArray(m_vao);
-  glDrawElements(GL_TRIANGLES,m_nind,GL_UNSIGNED_INT,0);
-}
\ No newline at end of file
+  DrawLOD(st,SelectLOD(st));
+}
+
+bool Sphere::CanDrawInstanced () const
+{
+  return true;
+}
+
+void Sphere::DrawInstanced (StatePtr st, int ninstances)
+{
+  m_levels[0]->DrawInstanced(st,ninstances);
+}
+
+int Sphere::GetLODCount () const
+{
+  return (int)m_levels.size();
+}
+
+float Sphere::GetLODLimit (int level) const
+{
+  return GetTessellationLimit(m_segments[level],1.0f);
+}
+
+void Sphere::DrawLOD (StatePtr st, int level)
+{
+  m_levels[level]->Draw(st);
+}
+
+void Sphere::DrawInstancedLOD (StatePtr st, int ninstances, int level)
+{
+  m_levels[level]->DrawInstanced(st,ninstances);
+}
+
+Bounds Sphere::GetBounds () const
+{
+  return Bounds(glm::vec3(-1.0f,-1.0f,-1.0f),glm::vec3(1.0f,1.0f,1.0f));
+}
+
+glm::vec4 Sphere::GetBoundingSphere () const
+{
+  return glm::vec4(0.0f,0.0f,0.0f,1.0f);
+}
@@ -6,15 +6,26 @@ using SpherePtr = std::shared_ptr<Sphere>;
 #define SPHERE_H
 
 #include "shape.h"
+#include "geometry.h"
+#include <vector>
 
 class Sphere : public Shape {
-  unsigned int m_vao;
-  unsigned int m_nind; // number of incident vertices
+  // precomputed tessellation levels, halved from the requested one
+  std::vector<GeometryPtr> m_levels;
+  std::vector<int> m_segments;   // segments around, per level
 protected:
   Sphere (int nstack, int nslice);
 public:
   static SpherePtr Make (int nstack=64, int nslice=64);
   virtual ~Sphere ();
   virtual void Draw (StatePtr st);
+  virtual Bounds GetBounds () const;
+  virtual glm::vec4 GetBoundingSphere () const;
+  virtual bool CanDrawInstanced () const;
+  virtual void DrawInstanced (StatePtr st, int ninstances);
+  virtual int GetLODCount () const;
+  virtual float GetLODLimit (int level) const;
+  virtual void DrawLOD (StatePtr st, int level);
+  virtual void DrawInstancedLOD (StatePtr st, int ninstances, int level);
 };
 #endif
@@ -15,39 +15,73 @@
 #include <GL/glew.h>
 #endif
 
+#include <cfloat>
 #include <iostream>
 #include <cstdlib>
 
-StatePtr State::Make (CameraPtr camera)
+#define ARENA_SIZE (64*1024)
+#define STACK_CAPACITY 64   // initial depth of the shader and matrix stacks
+
+StatePtr State::Make (CameraPtr camera, ArenaPtr arena)
 {
-  return StatePtr(new State(camera));
+  if (!arena)
+    arena = Arena::Make(ARENA_SIZE);
+  return StatePtr(new State(camera,arena));
 }
 
-State::State (CameraPtr camera)
+State::State (CameraPtr camera, ArenaPtr arena)
 : m_camera(camera),
-  m_shader(),
-  m_stack{glm::mat4(1.0f)}
+  m_arena(arena),
+  m_shader(ArenaAllocator<ShaderPtr>(arena.get())),
+  m_stack(ArenaAllocator<glm::mat4>(arena.get())),
+  m_frustum()
 {
-  glUseProgram(0);   // compatibility profile as default
+  m_textures.reserve(16);
+  m_caps.reserve(16);
+  BeginFrame(camera);
 }
 
 State::~State ()
 {
 }
 
+void State::BeginFrame (CameraPtr camera)
+{
+  m_camera = camera;
+  // drop the stacks before rewinding the arena they live in
+  m_shader = ShaderStack(ArenaAllocator<ShaderPtr>(m_arena.get()));
+  m_stack = MatrixStack(ArenaAllocator<glm::mat4>(m_arena.get()));
+  m_arena->Reset();
+  m_shader.reserve(STACK_CAPACITY);
+  m_stack.reserve(STACK_CAPACITY);
+  m_stack.push_back(glm::mat4(1.0f));
+  m_issued = 0;
+  m_elided = 0;
+  m_culling = false;
+  m_culled = 0;
+  m_visible = 0;
+  ResetGLState();
+  UseProgram(0);   // compatibility profile as default
+}
+
+ArenaPtr State::GetArena () const
+{
+  return m_arena;
+}
+
 void State::PushShader (ShaderPtr shd)
 {
   m_shader.push_back(shd);
-  shd->UseProgram();
+  UseProgram(shd->GetProgramId());
 }
 
 void State::PopShader ()
 {
   m_shader.pop_back();
   if (m_shader.empty())
-    glUseProgram(0);
+    UseProgram(0);
   else
-    m_shader.back()->UseProgram();
+    UseProgram(m_shader.back()->GetProgramId());
 }
 
 ShaderPtr State::GetShader () const
@@ -101,9 +135,239 @@ void State::LoadMatrices ()
     mv = m_camera->GetViewMatrix() * mv;  // to camera space
   }
   glm::mat4 mn = glm::transpose(glm::inverse(mv));
-  shd->SetUniform("Mvp",mvp);
-  shd->SetUniform("Mv",mv);
-  shd->SetUniform("Mn",mn);
+  shd->SetUniform(shd->GetUniformLocation(Shader::MVP),mvp);
+  shd->SetUniform(shd->GetUniformLocation(Shader::MV),mv);
+  shd->SetUniform(shd->GetUniformLocation(Shader::MN),mn);
+  // load camera
+  m_camera->Load(shared_from_this());
+}
+
+// Huge (FLT_MAX) when the camera is inside the sphere
+float State::GetProjectedUnitSize (const glm::mat4& model, const glm::vec4& sphere) const
+{
+  glm::mat4 proj = m_camera->GetProjMatrix();
+  glm::mat4 mv = m_camera->GetViewMatrix() * model;
+  float scale = glm::max(glm::length(glm::vec3(mv[0])),
+                glm::max(glm::length(glm::vec3(mv[1])),glm::length(glm::vec3(mv[2]))));
+  float size = 0.5f*proj[1][1]*scale;
+  if (proj[2][3] != 0.0f) {   // perspective
+    float dist = -(mv*glm::vec4(glm::vec3(sphere),1.0f)).z - sphere.w*scale;
+    if (dist <= 0.0f)
+      return FLT_MAX;
+    size /= dist;
+  }
+  return size;
+}
+
+// Culling uses the frustum of the camera at the time it is enabled
+void State::SetCulling (bool culling)
+{
+  m_culling = culling;
+  if (m_culling)
+    m_frustum = Frustum(m_camera->GetProjMatrix()*m_camera->GetViewMatrix());
+}
+
+bool State::IsCulling () const
+{
+  return m_culling;
+}
+
+const Frustum& State::GetFrustum () const
+{
+  return m_frustum;
+}
+
+void State::AddCulled (unsigned int n)
+{
+  m_culled += n;
+}
+
+void State::AddVisible (unsigned int n)
+{
+  m_visible += n;
+}
+
+unsigned int State::GetCulledCount () const
+{
+  return m_culled;
+}
+
+unsigned int State::GetVisibleCount () const
+{
+  return m_visible;
+}
+
+// Instanced draws: Mvp takes lighting space to clip space and each
+// instance gets its (Mv,Mn) pair, stored consecutively in data
+void State::LoadInstanceMatrices (const std::vector<glm::mat4>& models, std::vector<glm::mat4>& data)
+{
+  ShaderPtr shd = GetShader();
+  glm::mat4 view(1.0f);
+  glm::mat4 mvp = m_camera->GetProjMatrix();
+  if (shd->GetLightingSpace() == "camera")
+    view = m_camera->GetViewMatrix();
+  else
+    mvp = mvp * m_camera->GetViewMatrix();
+  data.resize(2*models.size());
+  for (size_t i=0; i<models.size(); ++i) {
+    glm::mat4 mv = view * models[i];
+    data[2*i+0] = mv;
+    data[2*i+1] = glm::transpose(glm::inverse(mv));
+  }
+  shd->SetUniform(shd->GetUniformLocation(Shader::MVP),mvp);
   // load camera
   m_camera->Load(shared_from_this());
-}
\ No newline at end of file
+}
+
+// Shaders that do not declare the decode uniforms only see attribute
+// geometry; the last values are kept to skip redundant updates
+void State::LoadDecode (const VertexDecode& d)
+{
+  ShaderPtr shd = GetShader();
+  int qloc = shd->GetUniformLocation(Shader::QUANTIZED);
+  int ploc = shd->GetUniformLocation(Shader::PROCSHAPE);
+  if (qloc < 0 && ploc < 0)
+    return;
+  const VertexDecode& c = m_decode;
+  if (c.program == d.program && c.quantized == d.quantized && c.shape == d.shape &&
+      (!d.quantized || (c.offset == d.offset && c.scale == d.scale)) &&
+      (!d.shape || (c.nx == d.nx && c.ny == d.ny))) {
+    m_elided++;
+    return;
+  }
+  shd->SetUniform(qloc,d.quantized ? 1 : 0);
+  if (d.quantized) {
+    shd->SetUniform(shd->GetUniformLocation(Shader::QOFFSET),d.offset);
+    shd->SetUniform(shd->GetUniformLocation(Shader::QSCALE),d.scale);
+  }
+  shd->SetUniform(ploc,d.shape);
+  if (d.shape) {
+    shd->SetUniform(shd->GetUniformLocation(Shader::PROCNX),d.nx);
+    shd->SetUniform(shd->GetUniformLocation(Shader::PROCNY),d.ny);
+  }
+  m_decode = d;
+  m_issued++;
+}
+
+void State::LoadVertexDecode (bool quantized, const glm::vec3& offset, const glm::vec3& scale)
+{
+  VertexDecode d = {GetShader()->GetProgramId(),quantized,offset,scale,0,0,0};
+  LoadDecode(d);
+}
+
+void State::LoadProceduralShape (int shape, int nx, int ny)
+{
+  VertexDecode d = {GetShader()->GetProgramId(),false,glm::vec3(0.0f),glm::vec3(1.0f),
+                    shape,nx,ny};
+  LoadDecode(d);
+}
+
+// GL state shadow: current state is unknown until first set
+static const unsigned int UNKNOWN = ~0u;
+
+void State::ResetGLState ()
+{
+  m_program = UNKNOWN;
+  m_vao = UNKNOWN;
+  m_unit = -1;
+  m_decode.program = UNKNOWN;
+  m_textures.clear();
+  m_caps.clear();
+}
+
+void State::UseProgram (unsigned int pid)
+{
+  if (pid == m_program) {
+    m_elided++;
+    return;
+  }
+  glUseProgram(pid);
+  m_program = pid;
+  m_issued++;
+}
+
+void State::ActiveTexture (int unit)
+{
+  if (unit == m_unit) {
+    m_elided++;
+    return;
+  }
+  glActiveTexture(GL_TEXTURE0+unit);
+  m_unit = unit;
+  m_issued++;
+}
+
+void State::BindTexture (unsigned int target, unsigned int tex)
+{
+  if (m_unit < 0) {    // active unit unknown
+    glBindTexture(target,tex);
+    m_issued++;
+    return;
+  }
+  if (m_unit >= int(m_textures.size()))
+    m_textures.resize(m_unit+1,TexBinding{UNKNOWN,UNKNOWN});
+  TexBinding& b = m_textures[m_unit];
+  if (b.target == target && b.tex == tex) {
+    m_elided++;
+    return;
+  }
+  glBindTexture(target,tex);
+  b.target = target;
+  b.tex = tex;
+  m_issued++;
+}
+
+void State::BindVertexArray (unsigned int vao)
+{
+  if (vao == m_vao) {
+    m_elided++;
+    return;
+  }
+  glBindVertexArray(vao);
+  m_vao = vao;
+  m_issued++;
+}
+
+// few capabilities are toggled: a linear search beats a map here
+State::CapBinding* State::FindCap (unsigned int cap)
+{
+  for (CapBinding& b : m_caps)
+    if (b.cap == cap)
+      return &b;
+  m_caps.push_back(CapBinding{cap,-1});
+  return &m_caps.back();
+}
+
+void State::Enable (unsigned int cap)
+{
+  CapBinding* b = FindCap(cap);
+  if (b->enabled == 1) {
+    m_elided++;
+    return;
+  }
+  glEnable(cap);
+  b->enabled = 1;
+  m_issued++;
+}
+
+void State::Disable (unsigned int cap)
+{
+  CapBinding* b = FindCap(cap);
+  if (b->enabled == 0) {
+    m_elided++;
+    return;
+  }
+  glDisable(cap);
+  b->enabled = 0;
+  m_issued++;
+}
+
+unsigned int State::GetIssuedCalls () const
+{
+  return m_issued;
+}
+
+unsigned int State::GetElidedCalls () const
+{
+  return m_elided;
+}
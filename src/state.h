@@ -8,19 +8,59 @@ using StatePtr = std::shared_ptr<State>;
 #include "camera.h"
 #include "light.h"
 #include "shader.h"
+#include "frustum.h"
+#include "arena.h"
 #include <glm/glm.hpp>
 #include <string>
 #include <vector>
 
 class State : public std::enable_shared_from_this<State> {
+  using ShaderStack = std::vector<ShaderPtr,ArenaAllocator<ShaderPtr>>;
+  using MatrixStack = std::vector<glm::mat4,ArenaAllocator<glm::mat4>>;
   CameraPtr m_camera;
-  std::vector<ShaderPtr> m_shader;
-  std::vector<glm::mat4> m_stack;
+  ArenaPtr m_arena;                    // per-frame memory, rewound by BeginFrame
+  ShaderStack m_shader;
+  MatrixStack m_stack;
+  // shadow of GL state, used to filter redundant calls
+  struct TexBinding {
+    unsigned int target;
+    unsigned int tex;
+  };
+  struct CapBinding {
+    unsigned int cap;
+    int enabled;                       // -1 while unknown
+  };
+  unsigned int m_program;
+  unsigned int m_vao;
+  int m_unit;                          // active texture unit
+  std::vector<TexBinding> m_textures;  // last binding per texture unit
+  std::vector<CapBinding> m_caps;      // enable bits
+  struct VertexDecode {
+    unsigned int program;              // program the values were set on
+    bool quantized;
+    glm::vec3 offset;
+    glm::vec3 scale;
+    int shape;                         // procedural shape (0: none)
+    int nx, ny;
+  };
+  VertexDecode m_decode;               // last vertex decode uniforms
+  unsigned int m_issued;               // GL calls issued
+  unsigned int m_elided;               // GL calls filtered out
+  // view frustum culling
+  bool m_culling;
+  Frustum m_frustum;
+  unsigned int m_culled;               // shapes rejected
+  unsigned int m_visible;              // shapes submitted
 protected:
-  State (CameraPtr camera);
+  State (CameraPtr camera, ArenaPtr arena);
+  CapBinding* FindCap (unsigned int cap);
+  void LoadDecode (const VertexDecode& decode);
 public:
-  static StatePtr Make (CameraPtr camera);
+  static StatePtr Make (CameraPtr camera, ArenaPtr arena=nullptr);
   virtual ~State ();
+  // reuse the state for a new frame: stacks, counters and GL shadow are reset
+  void BeginFrame (CameraPtr camera);
+  ArenaPtr GetArena () const;
   void PushShader (ShaderPtr shd);
   void PopShader ();
   void PushMatrix ();
@@ -31,6 +71,34 @@ public:
   ShaderPtr GetShader () const;
   CameraPtr GetCamera () const;
   void LoadMatrices ();
+  // projected size of one object unit at the nearest point of the
+  // bounding sphere (center, radius), as a fraction of the viewport height
+  float GetProjectedUnitSize (const glm::mat4& model, const glm::vec4& sphere) const;
+  void SetCulling (bool culling);
+  bool IsCulling () const;
+  const Frustum& GetFrustum () const;
+  void AddCulled (unsigned int n);
+  void AddVisible (unsigned int n);
+  unsigned int GetCulledCount () const;
+  unsigned int GetVisibleCount () const;
+  void LoadInstanceMatrices (const std::vector<glm::mat4>& models, std::vector<glm::mat4>& data);
+  // decoding of the vertex layout about to be drawn: compact geometry
+  // stores coord quantized (coord = offset + scale*stored coord)
+  void LoadVertexDecode (bool quantized, const glm::vec3& offset=glm::vec3(0.0f),
+                         const glm::vec3& scale=glm::vec3(1.0f));
+  // procedural geometry: no attributes, the vertex shader generates the
+  // shape over an nx x ny grid from gl_VertexID
+  void LoadProceduralShape (int shape, int nx, int ny);
+  // filtered GL state changes
+  void ResetGLState ();
+  void UseProgram (unsigned int pid);
+  void ActiveTexture (int unit);
+  void BindTexture (unsigned int target, unsigned int tex);
+  void BindVertexArray (unsigned int vao);
+  void Enable (unsigned int cap);
+  void Disable (unsigned int cap);
+  unsigned int GetIssuedCalls () const;
+  unsigned int GetElidedCalls () const;
 };
 
 #endif
\ No newline at end of file
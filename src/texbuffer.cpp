@@ -67,8 +67,8 @@ const std::string& TexBuffer::GetName () const
 void TexBuffer::Load (StatePtr st)
 {
   ShaderPtr shd = st->GetShader();
-  shd->ActiveTexture(m_varname.c_str());
-  glBindTexture(GL_TEXTURE_BUFFER,m_tex);
+  st->ActiveTexture(shd->ActiveTexture(m_varname));
+  st->BindTexture(GL_TEXTURE_BUFFER,m_tex);
 }
 
 void TexBuffer::Unload (StatePtr st)
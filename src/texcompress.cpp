@@ -0,0 +1,239 @@
+#include "texcompress.h"
+
+#ifdef _WIN32
+//#define GLAD_GL_IMPLEMENTATION // Necessary for headeronly version.
+#include <glad/gl.h>
+#elif __APPLE__
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TEX_COMPRESS_SSE2
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// S3TC is an extension (universally available on desktop GL)
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+unsigned int TexCompress::GetGLFormat (FORMAT fmt)
+{
+  switch (fmt) {
+    case BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case BC5: return GL_COMPRESSED_RG_RGTC2;
+  }
+  return 0;
+}
+
+size_t TexCompress::GetSize (FORMAT fmt, int width, int height)
+{
+  size_t nblocks = size_t((width+3)/4)*((height+3)/4);
+  return nblocks*(fmt == BC1 ? 8 : 16);
+}
+
+// 4x4 block as RGBA, edges repeated
+static void FetchBlock (const Image& img, int bx, int by, unsigned char rgba[64])
+{
+  int w = img.GetWidth(), h = img.GetHeight(), n = img.GetNChannels();
+  const unsigned char* data = img.GetData();
+  for (int j=0; j<4; ++j)
+    for (int i=0; i<4; ++i) {
+      int x = std::min(4*bx+i,w-1), y = std::min(4*by+j,h-1);
+      const unsigned char* p = data + (size_t(y)*w+x)*n;
+      unsigned char* q = rgba + 4*(4*j+i);
+      q[0] = p[0];
+      q[1] = n > 2 ? p[1] : p[0];
+      q[2] = n > 2 ? p[2] : p[0];
+      q[3] = n == 4 ? p[3] : n == 2 ? p[1] : 255;
+    }
+}
+
+static uint16_t To565 (const float c[3])
+{
+  int r = std::min(31,std::max(0,int(c[0]*31.0f/255.0f+0.5f)));
+  int g = std::min(63,std::max(0,int(c[1]*63.0f/255.0f+0.5f)));
+  int b = std::min(31,std::max(0,int(c[2]*31.0f/255.0f+0.5f)));
+  return uint16_t((r << 11) | (g << 5) | b);
+}
+
+static void From565 (uint16_t c, float rgb[3])
+{
+  int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+  rgb[0] = float((r << 3) | (r >> 2));
+  rgb[1] = float((g << 2) | (g >> 4));
+  rgb[2] = float((b << 3) | (b >> 2));
+}
+
+// nearest of 4 palette colours for the 16 texels, 2 bits each
+static uint32_t SelectIndices (const float* r, const float* g, const float* b,
+                               const float pal[4][3])
+{
+  uint32_t bits = 0;
+#ifdef TEX_COMPRESS_SSE2
+  for (int i=0; i<16; i+=4) {
+    __m128 R = _mm_loadu_ps(r+i), G = _mm_loadu_ps(g+i), B = _mm_loadu_ps(b+i);
+    __m128 best = _mm_set1_ps(1e30f);
+    __m128i index = _mm_setzero_si128();
+    for (int k=0; k<4; ++k) {
+      __m128 dr = _mm_sub_ps(R,_mm_set1_ps(pal[k][0]));
+      __m128 dg = _mm_sub_ps(G,_mm_set1_ps(pal[k][1]));
+      __m128 db = _mm_sub_ps(B,_mm_set1_ps(pal[k][2]));
+      __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr,dr),_mm_mul_ps(dg,dg)),_mm_mul_ps(db,db));
+      __m128i closer = _mm_castps_si128(_mm_cmplt_ps(d,best));
+      best = _mm_min_ps(d,best);
+      index = _mm_or_si128(_mm_andnot_si128(closer,index),
+                           _mm_and_si128(closer,_mm_set1_epi32(k)));
+    }
+    int32_t idx[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(idx),index);
+    for (int j=0; j<4; ++j)
+      bits |= uint32_t(idx[j]) << (2*(i+j));
+  }
+#else
+  for (int i=0; i<16; ++i) {
+    float best = 1e30f;
+    int index = 0;
+    for (int k=0; k<4; ++k) {
+      float dr = r[i]-pal[k][0], dg = g[i]-pal[k][1], db = b[i]-pal[k][2];
+      float d = dr*dr + dg*dg + db*db;
+      if (d < best) {
+        best = d;
+        index = k;
+      }
+    }
+    bits |= uint32_t(index) << (2*i);
+  }
+#endif
+  return bits;
+}
+
+static void Put16 (unsigned char* out, uint16_t v)
+{
+  out[0] = (unsigned char)(v & 0xff);
+  out[1] = (unsigned char)(v >> 8);
+}
+
+// colour block: endpoints at the extremes of the texels along their
+// principal axis (power iteration on the covariance)
+static void CompressColor (const unsigned char rgba[64], unsigned char out[8])
+{
+  float r[16], g[16], b[16];
+  float mean[3] = {0.0f, 0.0f, 0.0f};
+  for (int i=0; i<16; ++i) {
+    r[i] = rgba[4*i];
+    g[i] = rgba[4*i+1];
+    b[i] = rgba[4*i+2];
+    mean[0] += r[i];
+    mean[1] += g[i];
+    mean[2] += b[i];
+  }
+  for (int k=0; k<3; ++k)
+    mean[k] /= 16.0f;
+  float cov[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+  for (int i=0; i<16; ++i) {
+    float dr = r[i]-mean[0], dg = g[i]-mean[1], db = b[i]-mean[2];
+    cov[0] += dr*dr; cov[1] += dr*dg; cov[2] += dr*db;
+    cov[3] += dg*dg; cov[4] += dg*db; cov[5] += db*db;
+  }
+  float axis[3] = {1.0f, 1.0f, 1.0f};
+  for (int it=0; it<8; ++it) {
+    float x = cov[0]*axis[0] + cov[1]*axis[1] + cov[2]*axis[2];
+    float y = cov[1]*axis[0] + cov[3]*axis[1] + cov[4]*axis[2];
+    float z = cov[2]*axis[0] + cov[4]*axis[1] + cov[5]*axis[2];
+    float len = std::max(std::fabs(x),std::max(std::fabs(y),std::fabs(z)));
+    if (len < 1e-6f)
+      break;
+    axis[0] = x/len; axis[1] = y/len; axis[2] = z/len;
+  }
+  float tmin = 1e30f, tmax = -1e30f;
+  for (int i=0; i<16; ++i) {
+    float t = (r[i]-mean[0])*axis[0] + (g[i]-mean[1])*axis[1] + (b[i]-mean[2])*axis[2];
+    tmin = std::min(tmin,t);
+    tmax = std::max(tmax,t);
+  }
+  float e0[3], e1[3];
+  for (int k=0; k<3; ++k) {
+    e0[k] = mean[k] + axis[k]*tmax;
+    e1[k] = mean[k] + axis[k]*tmin;
+  }
+  uint16_t c0 = To565(e0), c1 = To565(e1);
+  // four colour mode needs c0 > c1
+  if (c0 < c1)
+    std::swap(c0,c1);
+  Put16(out,c0);
+  Put16(out+2,c1);
+  uint32_t bits = 0;
+  if (c0 != c1) {
+    float pal[4][3];
+    From565(c0,pal[0]);
+    From565(c1,pal[1]);
+    for (int k=0; k<3; ++k) {
+      pal[2][k] = (2.0f*pal[0][k] + pal[1][k])/3.0f;
+      pal[3][k] = (pal[0][k] + 2.0f*pal[1][k])/3.0f;
+    }
+    bits = SelectIndices(r,g,b,pal);
+  }
+  memcpy(out+4,&bits,4);   // little endian
+}
+
+// single channel block (BC4), in its 8 value mode
+static void CompressChannel (const unsigned char rgba[64], int channel, unsigned char out[8])
+{
+  int mn = 255, mx = 0;
+  for (int i=0; i<16; ++i) {
+    mn = std::min(mn,int(rgba[4*i+channel]));
+    mx = std::max(mx,int(rgba[4*i+channel]));
+  }
+  out[0] = (unsigned char)mx;
+  out[1] = (unsigned char)mn;
+  uint64_t bits = 0;
+  if (mx > mn) {
+    float scale = 7.0f/float(mx-mn);
+    for (int i=0; i<16; ++i) {
+      // steps from a0 (max) to a1 (min): 0 -> index 0, 7 -> 1, t -> t+1
+      int t = int(float(mx-rgba[4*i+channel])*scale + 0.5f);
+      uint64_t index = t == 0 ? 0 : t == 7 ? 1 : t+1;
+      bits |= index << (3*i);
+    }
+  }
+  for (int k=0; k<6; ++k)
+    out[2+k] = (unsigned char)(bits >> (8*k));
+}
+
+void TexCompress::Compress (FORMAT fmt, const Image& img, unsigned char* out)
+{
+  int nbx = (img.GetWidth()+3)/4, nby = (img.GetHeight()+3)/4;
+  unsigned char rgba[64];
+  for (int by=0; by<nby; ++by)
+    for (int bx=0; bx<nbx; ++bx) {
+      FetchBlock(img,bx,by,rgba);
+      switch (fmt) {
+        case BC1:
+          CompressColor(rgba,out);
+          out += 8;
+        break;
+        case BC3:
+          CompressChannel(rgba,3,out);
+          CompressColor(rgba,out+8);
+          out += 16;
+        break;
+        case BC5:
+          CompressChannel(rgba,0,out);
+          CompressChannel(rgba,1,out+8);
+          out += 16;
+        break;
+      }
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef TEX_COMPRESS_H
+#define TEX_COMPRESS_H
+
+#include "image.h"
+#include <cstddef>
+
+// Block compression of images (4x4 texel blocks, rows as stored in the
+// image): BC1 for opaque colour, BC3 for colour with alpha, BC5 for two
+// channel data such as normal maps (x, y only: BC5 samples return b = 0,
+// so shaders reading them must rebuild z = sqrt(1 - x^2 - y^2)).
+// Endpoints come from the principal axis of each block; indices are
+// searched four texels at a time with SSE2 when available.
+class TexCompress {
+public:
+  enum FORMAT {
+    BC1,    // 8 bytes per block, RGB
+    BC3,    // 16 bytes per block, RGB + A
+    BC5     // 16 bytes per block, R + G
+  };
+  // GL internal format of the blocks
+  static unsigned int GetGLFormat (FORMAT fmt);
+  static size_t GetSize (FORMAT fmt, int width, int height);
+  // images of 1 to 4 channels (grey: r = g = b; no alpha: opaque);
+  // out gets GetSize bytes
+  static void Compress (FORMAT fmt, const Image& img, unsigned char* out);
+};
+
+#endif
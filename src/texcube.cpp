@@ -67,8 +67,8 @@ unsigned int TexCube::GetTexId () const
 void TexCube::Load (StatePtr st)
 {
   ShaderPtr shd = st->GetShader();
-  shd->ActiveTexture(m_varname.c_str());
-  glBindTexture(GL_TEXTURE_CUBE_MAP,m_tex);
+  st->ActiveTexture(shd->ActiveTexture(m_varname));
+  st->BindTexture(GL_TEXTURE_CUBE_MAP,m_tex);
 }
 
 void TexCube::Unload (StatePtr st)
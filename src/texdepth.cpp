@@ -52,8 +52,8 @@ void TexDepth::SetCompareMode ()
 void TexDepth::Load (StatePtr st)
 {
   ShaderPtr shd = st->GetShader();
-  shd->ActiveTexture(m_varname.c_str());
-  glBindTexture(GL_TEXTURE_2D,m_tex);
+  st->ActiveTexture(shd->ActiveTexture(m_varname));
+  st->BindTexture(GL_TEXTURE_2D,m_tex);
 }
 
 void TexDepth::Unload (StatePtr st)
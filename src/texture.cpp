@@ -1,6 +1,9 @@
 #include "texture.h"
 #include "image.h"
 #include "state.h"
+#include "loader.h"
+#include "texcompress.h"
+#include "ktxfile.h"
 
 #include <glm/gtc/type_ptr.hpp>
 #ifdef _WIN32
@@ -12,11 +15,81 @@
 #include <GL/glew.h>
 #endif
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
+
+// sampling state, part of the cache key
+struct Sampling {
+  GLint wrap;
+  GLint min_filter;
+  GLint mag_filter;
+};
+static const Sampling FILE_SAMPLING = {GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR};
+static const Sampling TEXEL_SAMPLING = {GL_REPEAT, GL_NEAREST, GL_NEAREST};
+
+struct TextureEntry {
+  GLuint tex;
+  size_t bytes;
+  glm::vec3 texel;    // in the constant atlas (see Texture::Load)
+};
+static std::unordered_map<std::string,TextureEntry> s_entries;   // by content key
+static std::unordered_map<std::string,TexturePtr> s_handles;     // by sampler and content key
+static unsigned int s_hits = 0;
+static unsigned int s_misses = 0;
+static bool s_compression = false;
+static int s_max_size = 0;
+
+// constant textures are texels of a shared atlas, so that draws with
+// different constants keep the same binding
+#define ATLAS_SIZE 64
+static GLuint s_atlas = 0;
+static int s_atlas_used = 0;
+
+static std::string CacheKey (const Sampling& s, const std::string& source)
+{
+  return std::to_string(s.wrap) + "," + std::to_string(s.min_filter) + "," +
+         std::to_string(s.mag_filter) + ":" + source;
+}
+
+static void SetSampling (const Sampling& s)
+{
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,s.wrap);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,s.wrap);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,s.min_filter);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,s.mag_filter);
+}
+
+// handle of the sampler over the content (null when new); shared gets
+// the GL texture of the content when it is already loaded
+static TexturePtr& Lookup (const std::string& varname, const std::string& key,
+                           const TextureEntry** shared)
+{
+  TexturePtr& handle = s_handles[varname + "|" + key];
+  auto it = s_entries.find(key);
+  *shared = it != s_entries.end() ? &it->second : nullptr;
+  if (handle || *shared)
+    s_hits++;
+  else
+    s_misses++;
+  return handle;
+}
 
 TexturePtr Texture::Make (const std::string& varname, const std::string& filename)
 {
-  return TexturePtr(new Texture(varname,filename));
+  std::string key = CacheKey(FILE_SAMPLING,"file:" + filename);
+  const TextureEntry* shared;
+  TexturePtr& handle = Lookup(varname,key,&shared);
+  if (!handle && shared)
+    handle = TexturePtr(new Texture(varname,shared->tex,shared->texel));
+  else if (!handle) {
+    handle = TexturePtr(new Texture(varname,filename));
+    s_entries[key] = TextureEntry{handle->GetTexId(),3,glm::vec3(0.0f)};   // placeholder, until loaded
+  }
+  return handle;
 }
 TexturePtr Texture::Make (const std::string& varname, int width, int height)
 {
@@ -24,29 +97,213 @@ TexturePtr Texture::Make (const std::string& varname, int width, int height)
 }
 TexturePtr Texture::Make (const std::string& varname, const glm::vec3& texel)
 {
-  return TexturePtr(new Texture(varname,texel));
+  // keyed by the stored value
+  std::string key = CacheKey(TEXEL_SAMPLING,"texel:" + std::to_string(int(texel[0]*255)) + "," +
+                             std::to_string(int(texel[1]*255)) + "," +
+                             std::to_string(int(texel[2]*255)));
+  const TextureEntry* shared;
+  TexturePtr& handle = Lookup(varname,key,&shared);
+  if (!handle && shared)
+    handle = TexturePtr(new Texture(varname,shared->tex,shared->texel));
+  else if (!handle) {
+    handle = TexturePtr(new Texture(varname,texel));
+    s_entries[key] = TextureEntry{handle->GetTexId(),3,handle->m_texel};
+  }
+  return handle;
 }
 
-Texture::Texture (const std::string& varname, const std::string& filename)
-: m_varname(varname)
+void Texture::SetCompression (bool enabled)
+{
+  s_compression = enabled;
+}
+
+void Texture::SetMaxSize (int size)
+{
+  s_max_size = size;
+}
+
+Texture::CacheStats Texture::GetCacheStats ()
+{
+  CacheStats st = {(unsigned int)s_entries.size(), 0, s_hits, s_misses};
+  for (const auto& e : s_entries)
+    st.bytes += e.second.bytes;
+  return st;
+}
+
+// Levels (built on the CPU, see Image::MakeMipChain) go through a pixel
+// buffer: the driver returns as soon as they are copied into it, and the
+// transfer to the texture proceeds on the GPU
+static void Upload (GLuint tex, const std::vector<ImagePtr>& levels)
 {
+  GLenum format = levels[0]->GetNChannels()==3 ? GL_RGB : GL_RGBA;
+  std::vector<size_t> offsets;
+  size_t size = 0;
+  for (const ImagePtr& img : levels) {
+    offsets.push_back(size);
+    size += size_t(img->GetWidth())*img->GetHeight()*img->GetNChannels();
+  }
+  GLuint pbo;
+  glGenBuffers(1,&pbo);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER,pbo);
+  glBufferData(GL_PIXEL_UNPACK_BUFFER,size,nullptr,GL_STREAM_DRAW);
+  bool mapped = false;
+  unsigned char* dst = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER,0,size,
+                                                        GL_MAP_WRITE_BIT|GL_MAP_INVALIDATE_BUFFER_BIT);
+  if (dst) {
+    for (size_t l=0; l<levels.size(); ++l)
+      memcpy(dst+offsets[l],levels[l]->GetData(),
+             size_t(levels[l]->GetWidth())*levels[l]->GetHeight()*levels[l]->GetNChannels());
+    mapped = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+  }
+  if (!mapped)
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER,0);   // from client memory instead
+  glBindTexture(GL_TEXTURE_2D,tex);
+  glPixelStorei(GL_UNPACK_ALIGNMENT,1);       // rows are tightly packed
+  for (size_t l=0; l<levels.size(); ++l) {
+    const void* pixels = mapped ? (const void*)offsets[l] : levels[l]->GetData();
+    glTexImage2D(GL_TEXTURE_2D,GLint(l),format,levels[l]->GetWidth(),levels[l]->GetHeight(),0,
+                 format,GL_UNSIGNED_BYTE,pixels);
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT,4);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAX_LEVEL,GLint(levels.size())-1);
+  glBindTexture(GL_TEXTURE_2D,0);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER,0);
+  glDeleteBuffers(1,&pbo);
+}
+
+// Block compressed levels, from the sidecar or just compressed
+static void UploadCompressed (GLuint tex, uint32_t format, int width, int height,
+                              const std::vector<const unsigned char*>& data,
+                              const std::vector<uint32_t>& sizes)
+{
+  glBindTexture(GL_TEXTURE_2D,tex);
+  for (size_t l=0; l<data.size(); ++l)
+    glCompressedTexImage2D(GL_TEXTURE_2D,GLint(l),format,std::max(1,width>>l),
+                           std::max(1,height>>l),0,GLsizei(sizes[l]),data[l]);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAX_LEVEL,GLint(data.size())-1);
+  glBindTexture(GL_TEXTURE_2D,0);
+}
+
+// normal maps (by name) keep two channels; alpha only when not opaque
+static TexCompress::FORMAT CompressedFormat (const std::string& filename, const Image& img)
+{
+  if (filename.find("normal") != std::string::npos)
+    return TexCompress::BC5;
+  int n = img.GetNChannels();
+  if (n == 2 || n == 4) {
+    size_t npixels = size_t(img.GetWidth())*img.GetHeight();
+    for (size_t i=0; i<npixels; ++i)
+      if (img.GetData()[i*n+n-1] != 255)
+        return TexCompress::BC3;
+  }
+  return TexCompress::BC1;
+}
+
+// texture data prepared off the GL thread
+struct TextureLoad {
+  std::vector<ImagePtr> mips;                     // mip chain, or
+  KtxFilePtr ktx;                                 // up to date sidecar, or
+  uint32_t format;                                // levels just compressed
+  std::vector<std::vector<unsigned char>> levels;
+  int width, height;
+};
+
+// returns the bytes to upload
+static size_t PrepareTexture (const std::string& filename, bool compress, int max_size,
+                              TextureLoad& ld)
+{
+  // the sidecar holds the levels of one size limit
+  std::string params = max_size > 0 ? "max " + std::to_string(max_size) : std::string();
+  if (compress && (ld.ktx = KtxFile::Open(filename,params)))
+    return ld.ktx->GetDataSize();
   ImagePtr img = Image::Make(filename);
+  // the loader pool already spreads loads over the cores
+  int nthreads = Loader::GetWorkThreads();
+  if (max_size > 0)
+    img = Image::Fit(img,max_size,Image::KAISER,nthreads);
+  ld.mips = Image::MakeMipChain(img,Image::BOX,nthreads);
+  size_t size = 0;
+  if (!compress) {
+    for (const ImagePtr& level : ld.mips)
+      size += size_t(level->GetWidth())*level->GetHeight()*level->GetNChannels();
+    return size;
+  }
+  // compressed level by level
+  TexCompress::FORMAT fmt = CompressedFormat(filename,*img);
+  ld.format = TexCompress::GetGLFormat(fmt);
+  ld.width = img->GetWidth();
+  ld.height = img->GetHeight();
+  for (const ImagePtr& level : ld.mips) {
+    ld.levels.emplace_back(TexCompress::GetSize(fmt,level->GetWidth(),level->GetHeight()));
+    TexCompress::Compress(fmt,*level,ld.levels.back().data());
+    size += ld.levels.back().size();
+  }
+  ld.mips.clear();
+  KtxFile::Write(filename,params,ld.format,ld.width,ld.height,ld.levels);
+  return size;
+}
+
+Texture::Texture (const std::string& varname, const std::string& filename)
+: m_varname(varname),
+  m_texel_var(varname + "Texel"),
+  m_texel(0.0f),
+  m_shader(nullptr),
+  m_texel_slot(-1)
+{
+  // white 1x1 placeholder until the image is decoded (see Loader)
+  unsigned char white[3] = {255, 255, 255};
   glGenTextures(1,&m_tex);
   glBindTexture(GL_TEXTURE_2D,m_tex);
-  glTexImage2D(GL_TEXTURE_2D,0,img->GetNChannels()==3?GL_RGB:GL_RGBA,
-               img->GetWidth(),img->GetHeight(),0,
-               img->GetNChannels()==3?GL_RGB:GL_RGBA,
-               GL_UNSIGNED_BYTE,img->GetData());
-  glGenerateMipmap(GL_TEXTURE_2D);
-  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_REPEAT);	
-  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR_MIPMAP_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+  glTexImage2D(GL_TEXTURE_2D,0,GL_RGB,1,1,0,GL_RGB,GL_UNSIGNED_BYTE,white);
+  SetSampling(FILE_SAMPLING);
   glBindTexture(GL_TEXTURE_2D,0);
+  GLuint tex = m_tex;
+  std::string key = CacheKey(FILE_SAMPLING,"file:" + filename);
+  std::shared_ptr<TextureLoad> ld = std::make_shared<TextureLoad>();
+  bool compress = s_compression;
+  int max_size = s_max_size;
+  Loader::Submit([filename,compress,max_size,ld] () {
+                   return PrepareTexture(filename,compress,max_size,*ld);
+                 },
+                 [tex,ld,key] () {
+                   size_t bytes = 0;
+                   std::vector<const unsigned char*> data;
+                   std::vector<uint32_t> sizes;
+                   if (ld->ktx) {
+                     for (int l=0; l<ld->ktx->GetLevelCount(); ++l) {
+                       data.push_back(ld->ktx->GetLevelData(l));
+                       sizes.push_back(ld->ktx->GetLevelSize(l));
+                     }
+                     UploadCompressed(tex,ld->ktx->GetFormat(),ld->ktx->GetWidth(),
+                                      ld->ktx->GetHeight(),data,sizes);
+                     bytes = ld->ktx->GetDataSize();
+                   }
+                   else if (!ld->levels.empty()) {
+                     for (const std::vector<unsigned char>& level : ld->levels) {
+                       data.push_back(level.data());
+                       sizes.push_back((uint32_t)level.size());
+                       bytes += level.size();
+                     }
+                     UploadCompressed(tex,ld->format,ld->width,ld->height,data,sizes);
+                   }
+                   else {
+                     Upload(tex,ld->mips);
+                     for (const ImagePtr& level : ld->mips)
+                       bytes += size_t(level->GetWidth())*level->GetHeight()*level->GetNChannels();
+                   }
+                   auto it = s_entries.find(key);
+                   if (it != s_entries.end())
+                     it->second.bytes = bytes;
+                   *ld = TextureLoad();
+                 });
 }
 
 Texture::Texture (const std::string& varname, int width, int height)
-: m_varname(varname)
+: m_varname(varname),
+  m_texel_var(varname + "Texel"),
+  m_texel(0.0f),
+  m_shader(nullptr),
+  m_texel_slot(-1)
 {
   glGenTextures(1,&m_tex);
   glBindTexture(GL_TEXTURE_2D,m_tex);
@@ -60,23 +317,54 @@ Texture::Texture (const std::string& varname, int width, int height)
 }
 
 Texture::Texture (const std::string& varname, const glm::vec3& texel)
-: m_varname(varname)
+: m_varname(varname),
+  m_texel_var(varname + "Texel"),
+  m_texel(0.0f),
+  m_shader(nullptr),
+  m_texel_slot(-1)
 {
   unsigned char color[3] = {
     (unsigned char)(texel[0]*255),
     (unsigned char)(texel[1]*255),
     (unsigned char)(texel[2]*255),
   };
+  // one texel of the shared atlas, while it has room
+  if (s_atlas_used < ATLAS_SIZE*ATLAS_SIZE) {
+    if (!s_atlas) {
+      std::vector<unsigned char> white(3*ATLAS_SIZE*ATLAS_SIZE,255);
+      glGenTextures(1,&s_atlas);
+      glBindTexture(GL_TEXTURE_2D,s_atlas);
+      glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+      glTexImage2D(GL_TEXTURE_2D,0,GL_RGB,ATLAS_SIZE,ATLAS_SIZE,0,GL_RGB,GL_UNSIGNED_BYTE,white.data());
+      glPixelStorei(GL_UNPACK_ALIGNMENT,4);
+      SetSampling(TEXEL_SAMPLING);
+    }
+    int x = s_atlas_used % ATLAS_SIZE, y = s_atlas_used / ATLAS_SIZE;
+    s_atlas_used++;
+    m_tex = s_atlas;
+    m_texel = glm::vec3((x+0.5f)/ATLAS_SIZE,(y+0.5f)/ATLAS_SIZE,1.0f);
+    glBindTexture(GL_TEXTURE_2D,m_tex);
+    glTexSubImage2D(GL_TEXTURE_2D,0,x,y,1,1,GL_RGB,GL_UNSIGNED_BYTE,color);
+    glBindTexture(GL_TEXTURE_2D,0);
+    return;
+  }
   glGenTextures(1,&m_tex);
   glBindTexture(GL_TEXTURE_2D,m_tex);
   glTexImage2D(GL_TEXTURE_2D,0,GL_RGB,1,1,0,GL_RGB,GL_UNSIGNED_BYTE,color);
-  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_REPEAT);	
-  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+  SetSampling(TEXEL_SAMPLING);
   glBindTexture(GL_TEXTURE_2D,0);
 }
 
+Texture::Texture (const std::string& varname, unsigned int tex, const glm::vec3& texel)
+: m_tex(tex),
+  m_varname(varname),
+  m_texel_var(varname + "Texel"),
+  m_texel(texel),
+  m_shader(nullptr),
+  m_texel_slot(-1)
+{
+}
+
 
 Texture::~Texture ()
 {
@@ -90,8 +378,14 @@ unsigned int Texture::GetTexId () const
 void Texture::Load (StatePtr st)
 {
   ShaderPtr shd = st->GetShader();
-  shd->ActiveTexture(m_varname.c_str());
-  glBindTexture(GL_TEXTURE_2D,m_tex);
+  st->ActiveTexture(shd->ActiveTexture(m_varname));
+  st->BindTexture(GL_TEXTURE_2D,m_tex);
+  // (u, v, 1): sample the constant at that texel; 0: regular texture
+  if (shd.get() != m_shader) {
+    m_shader = shd.get();
+    m_texel_slot = shd->GetSlot(m_texel_var);
+  }
+  shd->SetSlot(m_texel_slot,m_texel);
 }
 
 void Texture::Unload (StatePtr st)
@@ -7,19 +7,46 @@ using TexturePtr = std::shared_ptr<Texture>;
 
 #include "appearance.h"
 #include <glm/glm.hpp>
+#include <cstddef>
 #include <string>
 
+// Textures made from files or texel values are cached, as the GL objects
+// of the context: the same file (or texel) with the same sampling shares
+// one GL texture, and the same sampler name gets the same handle back.
+// Mipmaps of file textures are built on the loader threads (see Image),
+// not with glGenerateMipmap.
+// Constant textures are texels of one shared atlas: shaders read them
+// through a "<sampler>Texel" uniform (u, v, 1), 0 for regular textures.
 class Texture : public Appearance {
   unsigned int m_tex;
   std::string m_varname;
+  std::string m_texel_var;   // "<varname>Texel" uniform
+  glm::vec3 m_texel;         // constants: atlas texel (u, v, 1); others: 0
+  const Shader* m_shader;    // shader of the texel slot (shaders are never deleted)
+  int m_texel_slot;
 protected:
   Texture (const std::string& varname, const std::string& filename);
   Texture (const std::string& varname, int width, int height);
   Texture (const std::string& varname, const glm::vec3& texel);
+  Texture (const std::string& varname, unsigned int tex, const glm::vec3& texel);   // shared
 public:
+  struct CacheStats {
+    unsigned int entries;   // GL textures
+    size_t bytes;           // texel memory, mipmaps included
+    unsigned int hits;
+    unsigned int misses;
+  };
   static TexturePtr Make (const std::string& varname, const std::string& filename);
   static TexturePtr Make (const std::string& varname, int width, int height);
   static TexturePtr Make (const std::string& varname, const glm::vec3& texel);
+  // block compress file textures with their mip chain (BC1; BC3 with
+  // alpha; BC5 for files named "*normal*", whose z the sampling shader
+  // has to rebuild), kept in a KTX sidecar (default: disabled)
+  static void SetCompression (bool enabled);
+  // file textures larger than size (in width or height) are halved to
+  // fit before upload; 0: no limit (default). Set before loading.
+  static void SetMaxSize (int size);
+  static CacheStats GetCacheStats ();
   virtual ~Texture ();
   unsigned int GetTexId () const;
   virtual void Load (StatePtr st);
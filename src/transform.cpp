@@ -1,5 +1,6 @@
 #include "transform.h"
 #include "state.h"
+#include "node.h"
 
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -12,6 +13,8 @@
 #include <GL/glew.h>
 #endif
 
+#include <algorithm>
+
 TransformPtr Transform::Make ()
 {
   return TransformPtr(new Transform());
@@ -27,28 +30,50 @@ Transform::~Transform ()
 void Transform::LoadIdentity ()
 {
   m_mat = glm::mat4(1.0f);
+  Invalidate();
 }
 void Transform::MultMatrix (const glm::mat4 mat)
 {
   m_mat *= mat;
+  Invalidate();
 }
 void Transform::Translate (float x, float y, float z)
 {
   m_mat = glm::translate(m_mat,glm::vec3(x,y,z));
+  Invalidate();
 }
 void Transform::Scale (float x, float y, float z)
 {
   m_mat = glm::scale(m_mat,glm::vec3(x,y,z));
+  Invalidate();
 }
 void Transform::Rotate (float angle, float x, float y, float z)
 {
   m_mat = glm::rotate(m_mat,glm::radians(angle),glm::vec3(x,y,z));
+  Invalidate();
 }
 const glm::mat4& Transform::GetMatrix() const
 {
   return m_mat;
 }
 
+void Transform::AttachNode (Node* node)
+{
+  m_nodes.push_back(node);
+}
+
+void Transform::DetachNode (Node* node)
+{
+  m_nodes.erase(std::remove(m_nodes.begin(),m_nodes.end(),node),m_nodes.end());
+}
+
+void Transform::Invalidate () const
+{
+  // the same transform may be shared by several nodes
+  for (Node* node : m_nodes)
+    node->Invalidate();
+}
+
 void Transform::Load (StatePtr st) const
 {
   st->PushMatrix();
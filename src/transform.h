@@ -6,11 +6,16 @@ using TransformPtr = std::shared_ptr<Transform>;
 #define TRANSFORM_H
 
 #include <glm/glm.hpp>
+#include <vector>
 
 #include "state.h"
 
+class Node;
+
 class Transform {
   glm::mat4 m_mat;
+  std::vector<Node*> m_nodes;  // nodes using this transform (notified on change)
+  void Invalidate () const;
 protected:
   Transform ();
 public:
@@ -22,6 +27,8 @@ public:
   void Scale (float x, float y, float z);
   void Rotate (float angle, float x, float y, float z);
   const glm::mat4& GetMatrix () const;
+  void AttachNode (Node* node);
+  void DetachNode (Node* node);
   void Load (StatePtr st) const;
   void Unload (StatePtr st) const;
 };
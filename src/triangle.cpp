@@ -1,6 +1,7 @@
 #include "triangle.h"
 
 #include <iostream>
+#include <vector>
 
 #ifdef _WIN32
 //#define GLAD_GL_IMPLEMENTATION // Necessary for headeronly version.
@@ -18,25 +19,30 @@ TrianglePtr Triangle::Make ()
 
 Triangle::Triangle ()
 {
-  float coord[] = {-1.0f,0.0f,1.0f,0.0f,0.0f,1.0f};
-  // create VAO
-  glGenVertexArrays(1,&m_vao);
-  glBindVertexArray(m_vao);
-  // create coord buffer
-  GLuint id;
-  glGenBuffers(1,&id);
-  glBindBuffer(GL_ARRAY_BUFFER,id);
-  glBufferData(GL_ARRAY_BUFFER,sizeof(coord),coord,GL_STATIC_DRAW);
-  glVertexAttribPointer(0,2,GL_FLOAT,GL_FALSE,0,0);  // coord
-  glEnableVertexAttribArray(0);
+  m_geom = Geometry::Find("triangle");
+  if (!m_geom) {
+    float coord[] = {-1.0f,0.0f,1.0f,0.0f,0.0f,1.0f};
+    std::vector<Geometry::Vertex> verts(3);
+    for (int i=0; i<3; ++i) {
+      verts[i].coord = glm::vec3(coord[2*i+0],coord[2*i+1],0.0f);
+      verts[i].normal = glm::vec3(0.0f,0.0f,1.0f);
+      verts[i].tangent = glm::vec3(1.0f,0.0f,0.0f);
+      verts[i].texcoord = glm::vec2(0.5f*(coord[2*i+0]+1.0f),coord[2*i+1]);
+    }
+    m_geom = Geometry::Make("triangle",verts,{0,1,2});
+  }
 }
 
 Triangle::~Triangle () 
 {
 }
 
-void Triangle::Draw (StatePtr )
+void Triangle::Draw (StatePtr st)
 {
-  glBindVertexArray(m_vao);
-  glDrawArrays(GL_TRIANGLES,0,3);
-}
\ No newline at end of file
+  m_geom->Draw(st);
+}
+
+Bounds Triangle::GetBounds () const
+{
+  return Bounds(glm::vec3(-1.0f,0.0f,0.0f),glm::vec3(1.0f,1.0f,0.0f));
+}
@@ -6,14 +6,16 @@ using TrianglePtr = std::shared_ptr<Triangle>;
 #define TRIANGLE_H
 
 #include "shape.h"
+#include "geometry.h"
 
 class Triangle : public Shape {
-  unsigned int m_vao;
+  GeometryPtr m_geom;
 protected:
   Triangle ();
 public:
   static TrianglePtr Make ();
   virtual ~Triangle ();
   virtual void Draw (StatePtr st);
+  virtual Bounds GetBounds () const;
 };
 #endif
\ No newline at end of file